@@ -6,14 +6,121 @@
 
 #include "config.h"
 
+#include <util/crc16.h>
+
 #include "union_station.h"
 #include "time.h"
 #include "ntp.h"
 #include "net.h"
 #include "lcd.h"
+#include "events.h"
+
+const fr12_eeprom fr12_config::defaults = {
+  // Header
+  {
+    // Magic
+    fr12_config_magic,
+
+    // Version
+    fr12_config_version
+  },
+
+  // Union Station
+  {
+    0,
+    fr12_union_station_boot_fast
+  },
+
+  // LCD
+  {
+    {
+      "Froshduino " FR12_VERSION,
+      255, 255, 255
+    }
+  },
+
+  // Network
+  {
+    0x00,
+    { 0x72, 0x65, 0x64, 0x64, 0x69, 0x74 },
+    0x6417a8c0, // 192.168.23.100
+    0x5418a8c0, // 192.168.24.84
+    0x0117a8c0, // 192.168.23.1
+    0x00ffffff  // 255.255.255.0
+  },
+
+  // NTP
+  { { "pool.ntp.org", "time.nist.gov" } },
+
+  // Time
+  {
+    fr12_time_default,
+    fr12_time_default_sync_interval,
+    0
+  },
+
+  // DHCP lease (none yet)
+  { 0, 0, 0, 0, 0 },
+
+  // Countdown targets
+  { 1, { { fr12_union_station_countdown_to, "" } } },
+
+  // CRCs, filled in by reset()
+  { 0 }
+};
+
+// Where each CRC-covered section lives, by index
+struct fr12_config_span {
+  uint16_t offset;
+  uint8_t size;
+};
+
+static const fr12_config_span fr12_config_spans[fr12_config_section_count] PROGMEM = {
+  { offsetof(fr12_eeprom, union_station), sizeof(fr12_union_station_serialized) },
+  { offsetof(fr12_eeprom, lcd), sizeof(fr12_lcd_serialized) },
+  { offsetof(fr12_eeprom, net), sizeof(fr12_net_serialized) },
+  { offsetof(fr12_eeprom, ntp), sizeof(fr12_ntp_serialized) },
+  { offsetof(fr12_eeprom, time), sizeof(fr12_time_serialized) },
+  { offsetof(fr12_eeprom, lease), sizeof(fr12_net_lease_serialized) },
+  { offsetof(fr12_eeprom, events), sizeof(fr12_events_serialized) }
+};
+
+// Upgrade path, oldest first. Add a row for every release, with the
+// section sizes of the layout it upgrades from spelled out, since the
+// structs will have moved on.
+const fr12_config_migration fr12_config::migrations[] = {
+  // 1.4.0 appends the CRC table; begin() fills it in
+  { 134, 140, NULL, 0, { 0 } },
+
+  // 1.4.1 adds the union station's boot flags
+  { 140, 141, &fr12_config::migrate_140, 5, { 4, 35, 23, 32, 8 } },
+
+  // 1.4.2 caches the DHCP lease after the time
+  { 141, 142, &fr12_config::migrate_141, 5, { 5, 35, 23, 32, 8 } },
+
+  // 1.4.3 keeps the clock's drift with the time
+  { 142, 143, &fr12_config::migrate_142, 6, { 5, 35, 23, 32, 8, 20 } },
+
+  // 1.4.4 takes up to four NTP servers
+  { 143, 144, &fr12_config::migrate_143, 6, { 5, 35, 23, 32, 12, 20 } },
+
+  // 1.4.5 keeps a table of countdown targets after the lease
+  { 144, 145, &fr12_config::migrate_144, 6, { 5, 35, 23, 128, 12, 20 } }
+};
+
+volatile fr12_config_pending fr12_config::queue[fr12_config_queue_len];
+volatile uint8_t fr12_config::queue_head = 0;
+volatile uint8_t fr12_config::queue_tail = 0;
+
+ISR(EE_READY_vect) {
+  fr12_config::write_back();
+}
 
 fr12_config::fr12_config(fr12_union_station *union_station) {
   this->union_station = union_station;
+  this->journal_slot = 0;
+  this->journal_sequence = 0;
+  this->damaged = 0;
 }
 
 fr12_config::~fr12_config() {
@@ -21,163 +128,435 @@ fr12_config::~fr12_config() {
 }
 
 void fr12_config::begin() {
-  // Step 1: Read the header.
-  fr12_eeprom_header *h = this->read_header();
+  fr12_eeprom ee;
+  uint8_t migrated = 0;
+
+  // Step 1: Read everything in one pass.
+  this->read(&ee);
 
-  // Step 2: Verify the magic bytes and version.
-  if (h->magic != fr12_config_magic || h->version != fr12_config_version) {
-    this->reset();
+  // Step 2: Verify the magic bytes, and bring older layouts up to date.
+  if (ee.header.magic != fr12_config_magic) {
+    this->reset(&ee);
+  }
+  else if (ee.header.version != fr12_config_version) {
+    this->damaged = this->migrate_check(&ee);
+    if (this->migrate(&ee)) {
+      migrated = 1;
+    }
+    else {
+      this->reset(&ee);
+    }
   }
 
-  // Step 3: Free memory.
-  free(h);
+  // Step 3: Check every section. After a migration the sections may have
+  // moved and the old CRCs mean nothing, so everything is written back (the
+  // write-back queue skips bytes that didn't change); what failed its old
+  // CRC, or doesn't make sense, goes back to its defaults first. Otherwise
+  // a bad section gets its defaults back and the rest are left alone.
+  for (uint8_t a = 0; a < fr12_config_section_count; a++) {
+    uint8_t bad;
+    if (migrated) {
+      bad = (this->damaged & (1 << a)) || !this->section_sane(&ee, a);
+    }
+    else if (this->section_crc(&ee, a) == ee.crc[a]) {
+      continue;
+    }
+    else {
+      bad = 1;
+    }
+
+    if (bad) {
+      fr12_config_span span;
+      memcpy_P(&span, &fr12_config_spans[a], sizeof(span));
+      memcpy_P((uint8_t *)&ee + span.offset, (const uint8_t *)&defaults + span.offset, span.size);
+    }
+    this->write_section(&ee, a);
+  }
+
+  if (migrated) {
+    ee.header.version = fr12_config_version;
+    this->write(&ee.header);
+  }
 
-  // Step 4: Configure stuff.
-  fr12_union_station_serialized *us = this->read_union_station();
-  this->union_station->configure(us);
-  free(us);
-  
-  fr12_lcd_serialized *lcd = this->read_lcd();
+  // Step 4: The journal has the latest time.
+  uint32_t seconds;
+  if (this->read_time_journal(&seconds)) {
+    ee.time.seconds = seconds;
+  }
+
+  // Step 5: Configure stuff.
+  this->union_station->events->configure(&ee.events);
+  this->union_station->configure(&ee.union_station);
+  this->union_station->lcd->configure(&ee.lcd);
+  this->union_station->net->configure(&ee.net);
+  this->union_station->ntp->configure(&ee.ntp);
+  this->union_station->time->configure(&ee.time);
+  this->union_station->net->configure_lease(&ee.lease);
+  this->union_station->do_select_event();
+}
+
+void fr12_config::reset() {
+  fr12_eeprom ee;
+  this->reset(&ee);
+}
+
+void fr12_config::reset(fr12_eeprom *ee) {
+  // Copy the defaults out of PROGMEM and checksum them
+  memcpy_P(ee, &defaults, sizeof(*ee));
+  for (uint8_t a = 0; a < fr12_config_section_count; a++) {
+    ee->crc[a] = this->section_crc(ee, a);
+  }
+  this->write(ee);
+
+  // Supersede whatever the journal holds, rather than erasing all of it
+  uint32_t seconds;
+  this->read_time_journal(&seconds);
+  this->write_time_journal(ee->time.seconds);
+}
+
+void fr12_config::write_union_station(void *ptr) {
+  fr12_union_station_serialized *union_station = (fr12_union_station_serialized *)ptr;
+  this->union_station->configure(union_station);
+  this->write(union_station);
+}
+
+void fr12_config::write_lcd(void *ptr) {
+  fr12_lcd_serialized *lcd = (fr12_lcd_serialized *)ptr;
   this->union_station->lcd->configure(lcd);
-  free(lcd);
+  this->write(lcd);
+}
 
-  fr12_net_serialized *net = this->read_net();
+void fr12_config::write_net(void *ptr) {
+  fr12_net_serialized *net = (fr12_net_serialized *)ptr;
   this->union_station->net->configure(net);
-  free(net);
+  this->write(net);
+}
 
-  fr12_ntp_serialized *ntp = this->read_ntp();
+void fr12_config::write_ntp(void *ptr) {
+  fr12_ntp_serialized *ntp = (fr12_ntp_serialized *)ptr;
   this->union_station->ntp->configure(ntp);
-  free(ntp);
+  this->write(ntp);
+}
 
-  fr12_time_serialized *time = this->read_time();
+void fr12_config::write_time(void *ptr) {
+  fr12_time_serialized *time = (fr12_time_serialized *)ptr;
   this->union_station->time->configure(time);
-  free(time);
+  this->union_station->do_schedule_sync();
+  this->write(time);
+  this->write_time_journal(time->seconds);
 }
 
-void fr12_config::reset() {
-  static fr12_eeprom ee PROGMEM = {
-    // Header
-    {
-      // Magic
-      fr12_config_magic,
+void fr12_config::write_lease(void *ptr) {
+  fr12_net_lease_serialized *lease = (fr12_net_lease_serialized *)ptr;
+  this->union_station->net->configure_lease(lease);
+  this->write(lease);
+}
 
-      // Version
-      fr12_config_version
-    },
+void fr12_config::write_time_journal(uint32_t seconds) {
+  fr12_time_journal_record record;
 
-    // Union Station
-    { fr12_union_station_countdown_to },
+  // Sequence numbers skip the erased value so blank slots never look valid
+  if (++this->journal_sequence == fr12_config_journal_empty) {
+    this->journal_sequence = 0;
+  }
 
-    // LCD
-    {
-      {
-        "Froshduino " FR12_VERSION,
-        255, 255, 255
+  record.sequence = this->journal_sequence;
+  record.seconds = seconds;
+  record.crc = this->time_journal_crc(&record);
+
+  // A record torn by a power loss fails its CRC, and the one before it wins
+  this->write((uint8_t *)&record, sizeof(record), fr12_config_journal_start + this->journal_slot * sizeof(record));
+
+  if (++this->journal_slot >= fr12_config_journal_slots) {
+    this->journal_slot = 0;
+  }
+}
+
+uint8_t fr12_config::migrate(fr12_eeprom *ee) {
+  uint16_t version = ee->header.version;
+
+  while (version != fr12_config_version) {
+    fr12_config_migration m;
+    uint8_t a;
+
+    for (a = 0; a < sizeof(migrations) / sizeof(migrations[0]); a++) {
+      memcpy_P(&m, &migrations[a], sizeof(m));
+      if (m.from == version) {
+        break;
       }
-    },
+    }
 
-    // Network
-    {
-      0x00,
-      { 0x72, 0x65, 0x64, 0x64, 0x69, 0x74 },
-      0x6417a8c0, // 192.168.23.100
-      0x5418a8c0, // 192.168.24.84
-      0x0117a8c0, // 192.168.23.1
-      0x00ffffff  // 255.255.255.0
-    },
-
-    // NTP
-    { "pool.ntp.org" },
-
-    // Time
-    {
-      fr12_time_default,
-      1UL
+    // No way forward from here
+    if (a == sizeof(migrations) / sizeof(migrations[0]) || m.to <= m.from) {
+      return 0;
     }
-  };
 
-  // Copy from PROGMEM to EEPROM
-  for (uint32_t a = 0; a < sizeof(ee); a++) {
-    _EEPUT(a, pgm_read_byte(a + (const prog_char *)&ee));
+    if (m.migrate != NULL) {
+      ((this)->*(m.migrate))(ee);
+    }
+    version = m.to;
   }
+
+  return 1;
 }
 
-fr12_eeprom_header *fr12_config::read_header() {
-  return (fr12_eeprom_header *)this->read(sizeof(fr12_eeprom_header), offsetof(fr12_eeprom, header));
+uint8_t fr12_config::migrate_check(fr12_eeprom *ee) {
+  fr12_config_migration m;
+  uint8_t damaged = 0, a;
+
+  for (a = 0; a < sizeof(migrations) / sizeof(migrations[0]); a++) {
+    memcpy_P(&m, &migrations[a], sizeof(m));
+    if (m.from == ee->header.version) {
+      break;
+    }
+  }
+  if (a == sizeof(migrations) / sizeof(migrations[0])) {
+    return 0;
+  }
+
+  // The CRC table follows the last section
+  uint16_t offset = sizeof(fr12_eeprom_header), table = offset;
+  for (a = 0; a < m.sections; a++) {
+    table += m.size[a];
+  }
+
+  for (a = 0; a < m.sections; a++) {
+    uint16_t crc;
+    memcpy(&crc, (uint8_t *)ee + table + a * sizeof(crc), sizeof(crc));
+    if (this->crc((uint8_t *)ee + offset, m.size[a]) != crc) {
+      damaged |= 1 << a;
+    }
+    offset += m.size[a];
+  }
+
+  return damaged;
 }
 
-fr12_union_station_serialized *fr12_config::read_union_station() {
-  return (fr12_union_station_serialized *)this->read(sizeof(fr12_union_station_serialized), offsetof(fr12_eeprom, union_station));
+void fr12_config::migrate_140(fr12_eeprom *ee) {
+  // Everything after the new byte moves up by one. The tail of the old CRC
+  // table falls off the end, but it gets recomputed anyway.
+  uint8_t *p = &ee->union_station.boot_flags;
+  memmove(p + 1, p, (uint8_t *)ee + sizeof(fr12_eeprom) - p - 1);
+  ee->union_station.boot_flags = fr12_union_station_boot_fast;
 }
 
-fr12_lcd_serialized *fr12_config::read_lcd() {
-  return (fr12_lcd_serialized *)this->read(sizeof(fr12_lcd_serialized), offsetof(fr12_eeprom, lcd));
+// Where the time section's drift goes in a 1.4.2 layout, which had one
+// NTP server. Later releases moved it, so it's worked out from the start
+// of the NTP section rather than taken from fr12_eeprom.
+static uint8_t *fr12_config_drift_142(fr12_eeprom *ee) {
+  return (uint8_t *)&ee->ntp + sizeof(ee->ntp.server[0]) + offsetof(fr12_time_serialized, drift);
 }
 
-fr12_net_serialized *fr12_config::read_net() {
-  return (fr12_net_serialized *)this->read(sizeof(fr12_net_serialized), offsetof(fr12_eeprom, net));
+void fr12_config::migrate_141(fr12_eeprom *ee) {
+  // The lease lands where the CRC table was. Start without one.
+  memset(fr12_config_drift_142(ee), 0x00, sizeof(ee->lease));
 }
 
-fr12_ntp_serialized *fr12_config::read_ntp() {
-  return (fr12_ntp_serialized *)this->read(sizeof(fr12_ntp_serialized), offsetof(fr12_eeprom, ntp));
+void fr12_config::migrate_142(fr12_eeprom *ee) {
+  // The lease moves up to make room
+  uint8_t *p = fr12_config_drift_142(ee);
+  memmove(p + sizeof(ee->time.drift), p, sizeof(ee->lease));
+  memset(p, 0x00, sizeof(ee->time.drift));
 }
 
-fr12_time_serialized *fr12_config::read_time() {
-  return (fr12_time_serialized *)this->read(sizeof(fr12_time_serialized), offsetof(fr12_eeprom, time));
+void fr12_config::migrate_143(fr12_eeprom *ee) {
+  // The new servers go in after the old one, and everything after moves up
+  uint8_t *p = ee->ntp.server[1];
+  size_t grow = sizeof(ee->ntp) - sizeof(ee->ntp.server[0]);
+  memmove(p + grow, p, (uint8_t *)ee + sizeof(fr12_eeprom) - p - grow);
+  memset(p, 0x00, grow);
+
+  // time.nist.gov used to stand in when the server didn't resolve. Keep it
+  // as a second source.
+  strcpy_P((char *)ee->ntp.server[1], PSTR("time.nist.gov"));
 }
 
-void fr12_config::write_header(fr12_eeprom_header *header) {
-  this->write((uint8_t *)header, sizeof(fr12_eeprom_header), offsetof(fr12_eeprom, header));
+void fr12_config::migrate_144(fr12_eeprom *ee) {
+  // The table lands where the CRC table was, and the old target becomes
+  // its only entry
+  memset(&ee->events, 0x00, sizeof(ee->events));
+  ee->events.count = 1;
+  ee->events.event[0].timestamp = ee->union_station.reserved;
+  ee->union_station.reserved = 0;
+
+  // A target out of a damaged section is no better than the rest of it
+  if (this->damaged & (1 << fr12_config_section_union_station)) {
+    this->damaged |= 1 << fr12_config_section_events;
+  }
 }
 
-void fr12_config::write_union_station(void *ptr) {
-  fr12_union_station_serialized *union_station = (fr12_union_station_serialized *)ptr;
-  this->union_station->configure(union_station);
-  this->write((uint8_t *)union_station, sizeof(fr12_union_station_serialized), offsetof(fr12_eeprom, union_station));
+uint16_t fr12_config::section_crc(fr12_eeprom *ee, uint8_t index) {
+  fr12_config_span span;
+  memcpy_P(&span, &fr12_config_spans[index], sizeof(span));
+  return this->crc((uint8_t *)ee + span.offset, span.size);
 }
 
-void fr12_config::write_lcd(void *ptr) {
-  fr12_lcd_serialized *lcd = (fr12_lcd_serialized *)ptr;
-  this->union_station->lcd->configure(lcd);
-  this->write((uint8_t *)lcd, sizeof(fr12_lcd_serialized), offsetof(fr12_eeprom, lcd));
+// Strings have to end inside their fields
+static uint8_t fr12_config_terminated(const uint8_t *s, size_t len) {
+  return memchr(s, '\0', len) != NULL;
 }
 
-void fr12_config::write_net(void *ptr) {
-  fr12_net_serialized *net = (fr12_net_serialized *)ptr;
-  this->union_station->net->configure(net);
-  this->write((uint8_t *)net, sizeof(fr12_net_serialized), offsetof(fr12_eeprom, net));
+uint8_t fr12_config::section_sane(fr12_eeprom *ee, uint8_t index) {
+  // Only what a corrupt image could get wrong that the modules wouldn't
+  // catch themselves. Layouts before 1.4.0 had no CRCs, so this is all
+  // that stands between them and a fresh set.
+  switch (index) {
+  case fr12_config_section_union_station:
+    return !(ee->union_station.boot_flags & ~fr12_union_station_boot_fast);
+  case fr12_config_section_lcd:
+    return fr12_config_terminated(ee->lcd.msg.text, sizeof(ee->lcd.msg.text));
+  case fr12_config_section_net:
+    return !(ee->net.flags & ~fr12_net_use_dhcp) && !(ee->net.mac[0] & 0x01);
+  case fr12_config_section_ntp:
+    for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+      if (!fr12_config_terminated(ee->ntp.server[a], sizeof(ee->ntp.server[a]))) {
+        return 0;
+      }
+    }
+    return ee->ntp.server[0][0] != '\0';
+  case fr12_config_section_time:
+    return ee->time.drift >= -fr12_time_drift_max && ee->time.drift <= fr12_time_drift_max;
+  case fr12_config_section_events:
+    if (ee->events.count > fr12_events_max) {
+      return 0;
+    }
+    for (uint8_t a = 0; a < ee->events.count; a++) {
+      if (!fr12_config_terminated((uint8_t *)ee->events.event[a].name, sizeof(ee->events.event[a].name))) {
+        return 0;
+      }
+    }
+    return 1;
+  }
+
+  return 1;
 }
 
-void fr12_config::write_ntp(void *ptr) {
-  fr12_ntp_serialized *ntp = (fr12_ntp_serialized *)ptr;
-  this->union_station->ntp->configure(ntp);
-  this->write((uint8_t *)ntp, sizeof(fr12_ntp_serialized), offsetof(fr12_eeprom, ntp));
+void fr12_config::write_section(fr12_eeprom *ee, uint8_t index) {
+  fr12_config_span span;
+  memcpy_P(&span, &fr12_config_spans[index], sizeof(span));
+  this->write((uint8_t *)ee + span.offset, span.size, span.offset);
+  this->write_crc(index, this->crc((uint8_t *)ee + span.offset, span.size));
 }
 
-void fr12_config::write_time(void *ptr) {
-  fr12_time_serialized *time = (fr12_time_serialized *)ptr;
-  this->union_station->time->configure(time);
-  this->write((uint8_t *)time, sizeof(fr12_time_serialized), offsetof(fr12_eeprom, time));
+void fr12_config::write_crc(uint8_t index, uint16_t crc) {
+  this->write((uint8_t *)&crc, sizeof(crc), offsetof(fr12_eeprom, crc) + index * sizeof(crc));
 }
 
-uint8_t *fr12_config::read(size_t len, size_t offset) {
-  uint8_t *ptr = (uint8_t *)malloc(len);
+uint16_t fr12_config::crc(uint8_t *ptr, size_t len) {
+  uint16_t crc = 0xffff;
 
-  if (ptr == NULL) {
-    return NULL;
+  for (size_t a = 0; a < len; a++) {
+    crc = _crc16_update(crc, ptr[a]);
   }
 
+  return crc;
+}
+
+uint8_t fr12_config::read_time_journal(uint32_t *seconds) {
+  uint8_t found = 0;
+
+  // Read what's queued, not what was there before
+  this->flush();
+
+  // Start over from the beginning when the journal is blank
+  this->journal_slot = 0;
+  this->journal_sequence = 0;
+
+  for (uint16_t slot = 0; slot < fr12_config_journal_slots; slot++) {
+    fr12_time_journal_record record;
+    uint8_t *ptr = (uint8_t *)&record;
+
+    for (uint8_t a = 0; a < sizeof(record); a++) {
+      _EEGET(ptr[a], fr12_config_journal_start + slot * sizeof(record) + a);
+    }
+
+    if (record.sequence == fr12_config_journal_empty || record.crc != this->time_journal_crc(&record)) {
+      continue;
+    }
+
+    // Records in use span far fewer than 32768 sequence numbers, so the
+    // signed difference orders them across a wrap
+    if (!found || (int16_t)(record.sequence - this->journal_sequence) > 0) {
+      *seconds = record.seconds;
+      this->journal_sequence = record.sequence;
+      this->journal_slot = slot + 1 < fr12_config_journal_slots ? slot + 1 : 0;
+      found = 1;
+    }
+  }
+
+  return found;
+}
+
+uint8_t fr12_config::time_journal_crc(fr12_time_journal_record *record) {
+  uint8_t crc = 0, *ptr = (uint8_t *)record;
+
+  for (uint8_t a = 0; a < offsetof(fr12_time_journal_record, crc); a++) {
+    crc = _crc_ibutton_update(crc, ptr[a]);
+  }
+
+  return crc;
+}
+
+void fr12_config::read(uint8_t *ptr, size_t len, size_t offset) {
+  // Read what's queued, not what was there before
+  this->flush();
+
   for (register size_t a = 0; a < len; a++) {
     _EEGET(ptr[a], a + offset);
   }
-
-  return ptr;
 }
 
 void fr12_config::write(uint8_t *ptr, size_t len, size_t offset) {
   for (register size_t a = 0; a < len; a++) {
-    _EEPUT(a + offset, ptr[a]);
+    this->put(a + offset, ptr[a]);
+  }
+}
+
+void fr12_config::put(uint16_t addr, uint8_t value) {
+  uint8_t next = (queue_head + 1) & (fr12_config_queue_len - 1);
+
+  // Full. The interrupt makes room one byte at a time.
+  while (next == queue_tail) {
+    eeprom_busy_wait();
+  }
+
+  queue[queue_head].addr = addr;
+  queue[queue_head].value = value;
+
+  // Publish the byte and arm EE_READY together, so the interrupt can't
+  // disarm itself in between
+  uint8_t sreg = SREG;
+  cli();
+  queue_head = next;
+  EECR |= _BV(EERIE);
+  SREG = sreg;
+}
+
+void fr12_config::flush() {
+  while (queue_head != queue_tail) {
+    eeprom_busy_wait();
+  }
+
+  // ... and the last byte has finished programming
+  eeprom_busy_wait();
+}
+
+void fr12_config::write_back() {
+  // Runs with interrupts off, and only once the previous write is done
+  while (queue_tail != queue_head) {
+    uint16_t addr = queue[queue_tail].addr;
+    uint8_t value = queue[queue_tail].value;
+    queue_tail = (queue_tail + 1) & (fr12_config_queue_len - 1);
+
+    // Unchanged bytes cost a read, not a 3.3 ms write and a cycle of wear
+    if (eeprom_read_byte((const uint8_t *)(uintptr_t)addr) != value) {
+      eeprom_write_byte((uint8_t *)(uintptr_t)addr, value);
+      return;
+    }
   }
+
+  // Nothing left
+  EECR &= ~_BV(EERIE);
 }
 
 
@@ -11,6 +11,8 @@
 
 #include "lcd.h"
 #include "net.h"
+#include "ntp.h"
+#include "events.h"
 
 // FR 12 classes
 class fr12_config;
@@ -24,15 +26,50 @@ enum {
   fr12_config_version = FR12_VERSION_NUMERIC
 };
 
+// Sections with a CRC, in fr12_eeprom order
+enum {
+  fr12_config_section_union_station = 0,
+  fr12_config_section_lcd,
+  fr12_config_section_net,
+  fr12_config_section_ntp,
+  fr12_config_section_time,
+  fr12_config_section_lease,
+  fr12_config_section_events,
+  fr12_config_section_count,
+  fr12_config_section_none = 0xff
+};
+
+// Write-back queue length (a power of two)
+enum {
+  fr12_config_queue_len = 64
+};
+
+// Time journal. Records fill the EEPROM from here to the end; the space
+// before it is left for fr12_eeprom to grow into.
+enum {
+  fr12_config_journal_start = 0x200,
+  fr12_config_journal_end = E2END + 1,
+  fr12_config_journal_empty = 0xffff
+};
+
+// A byte waiting to be written
+struct fr12_config_pending {
+  uint16_t addr;
+  uint8_t value;
+}
+__attribute__ ((packed));
+
 struct fr12_eeprom_header {
   uint32_t magic;
   uint16_t version;
 }
 __attribute__ ((packed));
 
-// Union Station
+// Union Station. The countdown target moved to fr12_events_serialized in
+// 1.4.5; its bytes stay so nothing after them moves.
 struct fr12_union_station_serialized {
-  uint32_t countdown_to;
+  uint32_t reserved;
+  uint8_t boot_flags;
 }
 __attribute__ ((packed));
 
@@ -53,9 +90,19 @@ struct fr12_net_serialized {
 }
 __attribute__ ((packed));
 
-// NTP
+// Last DHCP lease, kept for the next boot
+struct fr12_net_lease_serialized {
+  uint32_t ip;
+  uint32_t dns;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t expires;
+}
+__attribute__ ((packed));
+
+// NTP. Empty slots are unused.
 struct fr12_ntp_serialized {
-  uint8_t server[32];
+  uint8_t server[fr12_ntp_peers][fr12_ntp_hostname_size];
 }
 __attribute__ ((packed));
 
@@ -63,9 +110,29 @@ __attribute__ ((packed));
 struct fr12_time_serialized {
   uint32_t seconds;
   uint32_t sync_interval;
+  int32_t drift;
+}
+__attribute__ ((packed));
+
+// Countdown targets, as a min-heap on timestamp
+struct fr12_events_serialized {
+  uint8_t count;
+  fr12_event event[fr12_events_max];
 }
 __attribute__ ((packed));
 
+// One periodic save of the clock. The newest valid record wins at boot.
+struct fr12_time_journal_record {
+  uint16_t sequence;
+  uint32_t seconds;
+  uint8_t crc;
+}
+__attribute__ ((packed));
+
+enum {
+  fr12_config_journal_slots = (fr12_config_journal_end - fr12_config_journal_start) / sizeof(fr12_time_journal_record)
+};
+
 struct fr12_eeprom {
   fr12_eeprom_header header;
   fr12_union_station_serialized union_station;
@@ -73,9 +140,42 @@ struct fr12_eeprom {
   fr12_net_serialized net;
   fr12_ntp_serialized ntp;
   fr12_time_serialized time;
+  fr12_net_lease_serialized lease;
+  fr12_events_serialized events;
+  uint16_t crc[fr12_config_section_count];
 }
 __attribute__ ((packed));
 
+// Where each section lives in the EEPROM, and which CRC covers it
+template <typename T> struct fr12_config_section;
+
+#define FR12_CONFIG_SECTION(type, member, i) \
+  template <> struct fr12_config_section<type> { enum { offset = offsetof(fr12_eeprom, member), index = i }; }
+
+template <> struct fr12_config_section<fr12_eeprom> { enum { offset = 0, index = fr12_config_section_none }; };
+FR12_CONFIG_SECTION(fr12_eeprom_header, header, fr12_config_section_none);
+FR12_CONFIG_SECTION(fr12_union_station_serialized, union_station, fr12_config_section_union_station);
+FR12_CONFIG_SECTION(fr12_lcd_serialized, lcd, fr12_config_section_lcd);
+FR12_CONFIG_SECTION(fr12_net_serialized, net, fr12_config_section_net);
+FR12_CONFIG_SECTION(fr12_ntp_serialized, ntp, fr12_config_section_ntp);
+FR12_CONFIG_SECTION(fr12_time_serialized, time, fr12_config_section_time);
+FR12_CONFIG_SECTION(fr12_net_lease_serialized, lease, fr12_config_section_lease);
+FR12_CONFIG_SECTION(fr12_events_serialized, events, fr12_config_section_events);
+
+// Upgrades an image in place from one firmware version's layout to the next
+typedef void (fr12_config::*fr12_config_migration_callback)(fr12_eeprom *);
+
+// A step in the upgrade path. migrate is NULL when the layout didn't change.
+// The sizes are the sections of the layout it starts from, which sit back
+// to back after the header with their CRCs behind them; none means that
+// layout had no CRCs.
+struct fr12_config_migration {
+  uint16_t from, to;
+  fr12_config_migration_callback migrate;
+  uint8_t sections;
+  uint8_t size[fr12_config_section_count];
+};
+
 class fr12_config {
 public:
   friend class fr12_union_station;
@@ -90,30 +190,78 @@ public:
   // Initializes configuration
   void begin();
   
-  // Resets configuration
+  // Resets configuration. The second leaves the defaults it wrote in ee,
+  // so a caller that already has an image on the stack needn't read it back.
   void reset();
-protected:
-  // Readers
-  fr12_eeprom_header *read_header();
-  fr12_union_station_serialized *read_union_station();
-  fr12_lcd_serialized *read_lcd();
-  fr12_net_serialized *read_net();
-  fr12_ntp_serialized *read_ntp();
-  fr12_time_serialized *read_time();
+  void reset(fr12_eeprom *ee);
   
-  // Writers
-  void write_header(fr12_eeprom_header *header);
+  // Waits until every queued write has reached the EEPROM
+  void flush();
+  
+  // Writes the next queued byte that differs from the EEPROM (EE_READY)
+  static void write_back();
+  
+  // Reads or writes a whole section (or all of fr12_eeprom) in place
+  template <typename T> void read(T *ptr) {
+    this->read((uint8_t *)ptr, sizeof(T), fr12_config_section<T>::offset);
+  }
+  
+  template <typename T> void write(T *ptr) {
+    this->write((uint8_t *)ptr, sizeof(T), fr12_config_section<T>::offset);
+    if ((uint8_t)fr12_config_section<T>::index < fr12_config_section_count) {
+      this->write_crc(fr12_config_section<T>::index, this->crc((uint8_t *)ptr, sizeof(T)));
+    }
+  }
+protected:
+  // Writers, which also configure the module
   void write_union_station(void *ptr);
   void write_lcd(void *ptr);
   void write_net(void *ptr);
   void write_ntp(void *ptr);
   void write_time(void *ptr);
+  void write_lease(void *ptr);
+  
+  // Appends the time to the journal
+  void write_time_journal(uint32_t seconds);
 private:
-  uint8_t *read(size_t len, size_t offset);
+  // Finds the newest journal record and where the next one goes
+  uint8_t read_time_journal(uint32_t *seconds);
+  uint8_t time_journal_crc(fr12_time_journal_record *record);
+  
+  uint16_t journal_slot, journal_sequence;
+  
+  // Section CRCs and upgrades. damaged has a bit for each section that
+  // failed its CRC in the layout being upgraded.
+  uint8_t damaged;
+  uint8_t migrate(fr12_eeprom *ee);
+  uint8_t migrate_check(fr12_eeprom *ee);
+  void migrate_140(fr12_eeprom *ee);
+  void migrate_141(fr12_eeprom *ee);
+  void migrate_142(fr12_eeprom *ee);
+  void migrate_143(fr12_eeprom *ee);
+  void migrate_144(fr12_eeprom *ee);
+  uint16_t section_crc(fr12_eeprom *ee, uint8_t index);
+  uint8_t section_sane(fr12_eeprom *ee, uint8_t index);
+  void write_section(fr12_eeprom *ee, uint8_t index);
+  void write_crc(uint8_t index, uint16_t crc);
+  static uint16_t crc(uint8_t *ptr, size_t len);
+  
+  static const fr12_eeprom defaults PROGMEM;
+  static const fr12_config_migration migrations[] PROGMEM;
+  
+  void read(uint8_t *ptr, size_t len, size_t offset);
   void write(uint8_t *ptr, size_t len, size_t offset);
+  void put(uint16_t addr, uint8_t value);
   fr12_union_station *union_station;
+  
+  // Filled by put(), drained by write_back()
+  static volatile fr12_config_pending queue[fr12_config_queue_len];
+  static volatile uint8_t queue_head, queue_tail;
 };
 
+// The configuration must end before the journal starts
+typedef char fr12_config_journal_check[sizeof(fr12_eeprom) <= fr12_config_journal_start ? 1 : -1];
+
 #endif /* FR12_CONFIG_H */
 
 
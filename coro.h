@@ -0,0 +1,40 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#ifndef FR12_CORO_H
+#define FR12_CORO_H
+
+#include "defs.h"
+
+// Stackless coroutines, after Adam Dunkels' protothreads. A coroutine is a
+// function that picks up where it left off each time it's called. The line
+// it stopped on and when it started waiting are all it keeps, so locals
+// don't survive a wait, and a wait can't sit inside another switch.
+struct fr12_coro {
+  uint16_t line;
+  uint32_t since;
+};
+
+enum {
+  fr12_coro_done = 0xffff
+};
+
+#define FR12_CORO_INIT(c) ((c)->line = 0)
+#define FR12_CORO_DONE(c) ((c)->line == fr12_coro_done)
+
+#define FR12_CORO_BEGIN(c) switch ((c)->line) { case 0:
+#define FR12_CORO_END(c) (c)->line = fr12_coro_done; case fr12_coro_done:; }
+
+// Gives the rest of the loop a turn
+#define FR12_CORO_YIELD(c) do { (c)->line = __LINE__; return; case __LINE__:; } while (0)
+
+// Comes back until cond holds
+#define FR12_CORO_WAIT_UNTIL(c, cond) do { (c)->line = __LINE__; case __LINE__: if (!(cond)) return; } while (0)
+
+// Comes back until ms have gone by
+#define FR12_CORO_DELAY(c, ms) do { (c)->since = millis(); FR12_CORO_WAIT_UNTIL(c, millis() - (c)->since >= (uint32_t)(ms)); } while (0)
+
+#endif /* FR12_CORO_H */
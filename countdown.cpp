@@ -7,10 +7,33 @@
 #include "countdown.h"
 #include "time.h"
 
+// What each byte of digits wraps to when it borrows. Days don't wrap; a
+// borrow out of them is the mark.
+static const uint8_t fr12_countdown_wrap[fr12_countdown_digit_cs / 2] PROGMEM = {
+  0x99, 0x99, 0x99, 0x23, 0x59, 0x59
+};
+
+// Two BCD digits of v (under 100), without dividing
+static uint8_t fr12_countdown_to_bcd(uint8_t v) {
+  uint8_t tens = 0;
+  while (v >= 10) {
+    v -= 10;
+    tens++;
+  }
+  return tens << 4 | v;
+}
+
+static uint8_t fr12_countdown_from_bcd(uint8_t b) {
+  return (b >> 4) * 10 + (b & 0x0f);
+}
+
 fr12_countdown::fr12_countdown(uint32_t timestamp) {
   this->timestamp = timestamp;
-  this->days = this->hours = this->mins = this->secs = this->millis = 0;
-  this->reached = 0;
+  this->seen = 0;
+  this->reached = this->synced = 0;
+  memset(&this->bcd, 0x00, sizeof(this->bcd));
+  this->millis = 0;
+  this->changes = FR12_COUNTDOWN_ALL;
 }
 
 fr12_countdown::~fr12_countdown() {
@@ -18,29 +41,122 @@ fr12_countdown::~fr12_countdown() {
 }
 
 void fr12_countdown::update(fr12_time *time) {
-  // Take the difference between now and the timestamp
-  uint32_t s = this->timestamp - time->now(), m, h;
-  
-  // We WANT this counter to roll over (one below zero) - then we're sure that the countdown is done
-  if (s == 0xffffffff) {
-    this->days = this->hours = this->mins = this->secs = this->millis = 0;
+  uint8_t old[fr12_countdown_bytes];
+  uint16_t ms;
+  uint32_t now = time->now(&ms);
+
+  memcpy(&old, &this->bcd, sizeof(old));
+
+  // Usually this is the same second or the next one. Anything else is the
+  // clock being set or stepped, so work the digits out again.
+  if (!this->synced || (now != this->seen && now != this->seen + 1)) {
+    this->resync(this->timestamp - now);
+  }
+  else if (now != this->seen) {
+    this->reached = this->tick();
+  }
+  this->seen = now;
+  this->synced = 1;
+
+  // Centiseconds, counted out by subtraction. A slewed second can run a
+  // millisecond or two long.
+  if (!this->reached) {
+    uint16_t left = ms < 1000 ? 1000 - ms : 0;
+    uint8_t tenths = 0, hundredths = 0;
+    this->millis = left;
+    if (left > 999) {
+      left = 999;
+    }
+    while (left >= 100) {
+      left -= 100;
+      tenths++;
+    }
+    while (left >= 10) {
+      left -= 10;
+      hundredths++;
+    }
+    this->bcd[fr12_countdown_digit_cs / 2] = tenths << 4 | hundredths;
+  }
+  else {
+    this->millis = 0;
+  }
+
+  for (uint8_t a = 0; a < fr12_countdown_bytes; a++) {
+    uint8_t diff = old[a] ^ this->bcd[a];
+    if (diff & 0xf0) {
+      this->changes |= 1 << (a * 2);
+    }
+    if (diff & 0x0f) {
+      this->changes |= 1 << (a * 2 + 1);
+    }
+  }
+}
+
+void fr12_countdown::resync(uint32_t left) {
+  // We WANT this counter to roll over (one below zero) - then we're sure
+  // that the countdown is done
+  if ((int32_t)left < 0) {
+    memset(&this->bcd, 0x00, sizeof(this->bcd));
     this->reached = 1;
     return;
   }
-  
-  this->secs = s % 60;
-  m = s / 60;
-  this->mins = m % 60;
-  h = m / 60;
-  this->hours = h % 24;
-  this->days = h / 24;
-  this->millis = 1000 - time->time_millis;
+
+  uint32_t m = left / 60, h = m / 60;
+  uint16_t days = h / 24;
+
+  this->bcd[fr12_countdown_digit_secs / 2] = fr12_countdown_to_bcd(left % 60);
+  this->bcd[fr12_countdown_digit_mins / 2] = fr12_countdown_to_bcd(m % 60);
+  this->bcd[fr12_countdown_digit_hours / 2] = fr12_countdown_to_bcd(h % 24);
+  this->bcd[2] = fr12_countdown_to_bcd(days % 100);
+  days /= 100;
+  this->bcd[1] = fr12_countdown_to_bcd(days % 100);
+  this->bcd[0] = fr12_countdown_to_bcd(days / 100);
+  this->reached = 0;
+}
+
+uint8_t fr12_countdown::tick() {
+  // Take a second off, borrowing up through the bytes
+  for (int8_t a = fr12_countdown_digit_secs / 2; a >= 0; a--) {
+    uint8_t *b = &this->bcd[a];
+    if (*b != 0) {
+      *b -= (*b & 0x0f) ? 0x01 : 0x07;
+      return 0;
+    }
+    *b = pgm_read_byte(&fr12_countdown_wrap[a]);
+  }
+
+  // It was all zeroes, so we're one below zero
+  memset(&this->bcd, 0x00, sizeof(this->bcd));
+  return 1;
+}
+
+uint8_t fr12_countdown::get_digit(uint8_t digit) {
+  uint8_t b = this->bcd[digit / 2];
+  return (digit & 1) ? (b & 0x0f) : (b >> 4);
+}
+
+uint16_t fr12_countdown::get_changes() {
+  uint16_t changes = this->changes;
+  this->changes = 0;
+  return changes;
+}
+
+void fr12_countdown::invalidate() {
+  this->changes = FR12_COUNTDOWN_ALL;
 }
 
 uint32_t fr12_countdown::get_timestamp() {
   return this->timestamp;
 }
 
+void fr12_countdown::serialize(fr12_countdown_serialized *ee) {
+  ee->days = fr12_countdown_from_bcd(this->bcd[0]) * 10000U + fr12_countdown_from_bcd(this->bcd[1]) * 100U + fr12_countdown_from_bcd(this->bcd[2]);
+  ee->hours = fr12_countdown_from_bcd(this->bcd[fr12_countdown_digit_hours / 2]);
+  ee->mins = fr12_countdown_from_bcd(this->bcd[fr12_countdown_digit_mins / 2]);
+  ee->secs = fr12_countdown_from_bcd(this->bcd[fr12_countdown_digit_secs / 2]);
+  ee->millis = this->millis;
+}
+
 uint8_t fr12_countdown::target_reached() {
   return this->reached;
 }
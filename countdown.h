@@ -9,10 +9,31 @@
 
 #include "defs.h"
 
+// Digits of time left, most significant first: six of days, then two each
+// of hours, minutes, seconds and centiseconds. Two to a byte, in BCD.
+enum {
+  fr12_countdown_digit_days = 0,
+  fr12_countdown_digit_hours = 6,
+  fr12_countdown_digit_mins = 8,
+  fr12_countdown_digit_secs = 10,
+  fr12_countdown_digit_cs = 12,
+  fr12_countdown_digits = 14,
+  fr12_countdown_bytes = fr12_countdown_digits / 2
+};
+
+// Every digit in a change mask
+#define FR12_COUNTDOWN_ALL ((uint16_t)((1 << fr12_countdown_digits) - 1))
+
 // FR 12 classes
 class fr12_time;
 class fr12_countdown;
 
+// Time left, as served over HTTP
+struct fr12_countdown_serialized {
+  uint16_t days, hours, mins, secs, millis;
+}
+__attribute__ ((packed));
+
 class fr12_countdown {
 public:
   // Constructor, with timestamp
@@ -21,23 +42,40 @@ public:
   // Destructor
   virtual ~fr12_countdown();
   
-  // Updates to a time object
+  // Updates to a time object. Counts down a second at a time, and starts
+  // over from the timestamp when the clock jumps.
   void update(fr12_time *time);
   
+  // One digit of the time left, by fr12_countdown_digit_*
+  uint8_t get_digit(uint8_t digit);
+  
+  // Digits that changed since the last call, bit n for digit n
+  uint16_t get_changes();
+  
+  // Marks every digit changed, as after the screen is cleared
+  void invalidate();
+  
   // Gets the timestamp
   uint32_t get_timestamp();
   
+  // Copies out the time left
+  void serialize(fr12_countdown_serialized *ee);
+  
   // Returns true if the target has been reached
   uint8_t target_reached();
-  
-  // Cached data
-  uint16_t days, hours, mins, secs, millis;
 private:
+  void resync(uint32_t left);
+  uint8_t tick();
+  
   // Whether we've reached our mark or not
-  uint8_t reached;
+  uint8_t reached, synced;
+  
+  // Timestamp, and the clock's second at the last update
+  uint32_t timestamp, seen;
   
-  // Timestamp
-  uint32_t timestamp;
+  // Time left, and the digits that changed
+  uint8_t bcd[fr12_countdown_bytes];
+  uint16_t millis, changes;
 };
 
 #endif /* FR12_COUNTDOWN_H */
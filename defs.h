@@ -20,7 +20,15 @@
 
 class fr12_union_station;
 
-#define FR12_VERSION "1.3.4"
-#define FR12_VERSION_NUMERIC 134
+// Jumps to the reset vector. The host build hands this to its harness.
+#ifdef FR12_HOST
+void fr12_host_reset();
+#define FR12_SOFT_RESET() fr12_host_reset()
+#else
+#define FR12_SOFT_RESET() __asm__ __volatile__ ("jmp 0x00")
+#endif
+
+#define FR12_VERSION "1.4.5"
+#define FR12_VERSION_NUMERIC 145
 
 #endif /* FR12_DEFS_H */
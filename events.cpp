@@ -0,0 +1,153 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "events.h"
+#include "config.h"
+
+fr12_events::fr12_events() {
+  memset(&this->heap, 0x00, sizeof(this->heap));
+  this->count = 0;
+}
+
+fr12_events::~fr12_events() {
+
+}
+
+void fr12_events::configure(fr12_events_serialized *ee) {
+  this->count = ee->count > fr12_events_max ? fr12_events_max : ee->count;
+  memcpy(&this->heap, &ee->event, sizeof(this->heap));
+  for (uint8_t a = 0; a < this->count; a++) {
+    this->heap[a].name[fr12_event_name_size - 1] = '\0';
+  }
+
+  // The EEPROM holds a heap already, but it costs next to nothing to make
+  // sure
+  for (uint8_t a = this->count / 2; a > 0; a--) {
+    this->sift_down(a - 1);
+  }
+}
+
+void fr12_events::serialize(fr12_events_serialized *ee) {
+  ee->count = this->count;
+  memcpy(&ee->event, &this->heap, sizeof(ee->event));
+}
+
+void fr12_events::list(fr12_events_serialized *ee) {
+  // Insertion sort. There are only ever a few.
+  this->serialize(ee);
+  for (uint8_t a = 1; a < ee->count; a++) {
+    fr12_event event = ee->event[a];
+    uint8_t b = a;
+    for (; b > 0 && ee->event[b - 1].timestamp > event.timestamp; b--) {
+      ee->event[b] = ee->event[b - 1];
+    }
+    ee->event[b] = event;
+  }
+}
+
+uint8_t fr12_events::add(uint32_t timestamp, const char *name) {
+  uint8_t index = this->find(timestamp);
+
+  // A new target goes in at the bottom and rises to its place
+  if (index == fr12_events_none) {
+    if (this->count >= fr12_events_max) {
+      return 0;
+    }
+    index = this->count++;
+    this->heap[index].timestamp = timestamp;
+  }
+
+  strncpy(this->heap[index].name, name, fr12_event_name_size - 1);
+  this->heap[index].name[fr12_event_name_size - 1] = '\0';
+  this->sift_up(index);
+  return 1;
+}
+
+uint8_t fr12_events::remove(uint32_t timestamp) {
+  uint8_t index = this->find(timestamp);
+  if (index == fr12_events_none) {
+    return 0;
+  }
+
+  this->remove_at(index);
+  return 1;
+}
+
+uint8_t fr12_events::peek(fr12_event *event) {
+  if (this->count == 0) {
+    return 0;
+  }
+
+  memcpy(event, &this->heap[0], sizeof(*event));
+  return 1;
+}
+
+void fr12_events::pop() {
+  if (this->count > 0) {
+    this->remove_at(0);
+  }
+}
+
+uint8_t fr12_events::find(uint32_t timestamp) {
+  for (uint8_t a = 0; a < this->count; a++) {
+    if (this->heap[a].timestamp == timestamp) {
+      return a;
+    }
+  }
+
+  return fr12_events_none;
+}
+
+uint8_t fr12_events::get_count() {
+  return this->count;
+}
+
+void fr12_events::remove_at(uint8_t index) {
+  // The last target fills the hole, then moves whichever way it has to
+  this->count--;
+  if (index == this->count) {
+    return;
+  }
+
+  this->heap[index] = this->heap[this->count];
+  this->sift_down(index);
+  this->sift_up(index);
+}
+
+void fr12_events::sift_up(uint8_t index) {
+  while (index > 0) {
+    uint8_t parent = (index - 1) / 2;
+    if (this->heap[parent].timestamp <= this->heap[index].timestamp) {
+      break;
+    }
+    this->swap(parent, index);
+    index = parent;
+  }
+}
+
+void fr12_events::sift_down(uint8_t index) {
+  for (;;) {
+    uint8_t least = index, child = index * 2 + 1;
+
+    if (child < this->count && this->heap[child].timestamp < this->heap[least].timestamp) {
+      least = child;
+    }
+    if (child + 1 < this->count && this->heap[child + 1].timestamp < this->heap[least].timestamp) {
+      least = child + 1;
+    }
+    if (least == index) {
+      break;
+    }
+    this->swap(index, least);
+    index = least;
+  }
+}
+
+void fr12_events::swap(uint8_t a, uint8_t b) {
+  fr12_event event = this->heap[a];
+  this->heap[a] = this->heap[b];
+  this->heap[b] = event;
+}
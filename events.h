@@ -0,0 +1,75 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#ifndef FR12_EVENTS_H
+#define FR12_EVENTS_H
+
+#include "defs.h"
+
+// Limits. Names fit in the caption.
+enum {
+  fr12_events_max = 8,
+  fr12_event_name_size = 11,
+  fr12_events_none = 0xff
+};
+
+// A countdown target
+struct fr12_event {
+  uint32_t timestamp;
+  char name[fr12_event_name_size];
+}
+__attribute__ ((packed));
+
+// FR 12 classes
+class fr12_events;
+
+// FR 12 structs
+struct fr12_events_serialized;
+
+class fr12_events {
+public:
+  // Constructor
+  fr12_events();
+
+  // Destructor
+  virtual ~fr12_events();
+
+  // Configuration
+  void configure(fr12_events_serialized *ee);
+  void serialize(fr12_events_serialized *ee);
+
+  // Copies the targets out nearest first
+  void list(fr12_events_serialized *ee);
+
+  // Adds a target, or renames the one already at that time. Returns 0 if
+  // the table is full.
+  uint8_t add(uint32_t timestamp, const char *name);
+
+  // Removes the target at a time. Returns 0 if there isn't one.
+  uint8_t remove(uint32_t timestamp);
+
+  // Copies out the nearest target. Returns 0 if there are none.
+  uint8_t peek(fr12_event *event);
+
+  // Retires the nearest target
+  void pop();
+
+  // Where the target at a time is, or fr12_events_none
+  uint8_t find(uint32_t timestamp);
+
+  uint8_t get_count();
+private:
+  void remove_at(uint8_t index);
+  void sift_up(uint8_t index);
+  void sift_down(uint8_t index);
+  void swap(uint8_t a, uint8_t b);
+
+  // Min-heap on timestamp: each target is no later than its children
+  fr12_event heap[fr12_events_max];
+  uint8_t count;
+};
+
+#endif /* FR12_EVENTS_H */
@@ -0,0 +1,65 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Arduino core. Only what fr12 uses is provided.
+
+#ifndef FR12_HOST_ARDUINO_H
+#define FR12_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <avr/io.h>
+
+#include "Print.h"
+#include "Stream.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+typedef uint8_t boolean;
+typedef uint8_t byte;
+
+// Timing (32 bits wide, as on the AVR; see fr12_host.h for the clock)
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Pins
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+// Interrupts
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+// Bits and bytes
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+static inline uint16_t word(uint16_t w) { return w; }
+static inline uint16_t word(uint8_t h, uint8_t l) { return (uint16_t)(h << 8) | l; }
+
+#endif /* FR12_HOST_ARDUINO_H */
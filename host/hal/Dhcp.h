@@ -0,0 +1,18 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Ethernet library's DHCP constants.
+
+#ifndef FR12_HOST_DHCP_H
+#define FR12_HOST_DHCP_H
+
+#define DHCP_CHECK_NONE 0
+#define DHCP_CHECK_RENEW_FAIL 1
+#define DHCP_CHECK_RENEW_OK 2
+#define DHCP_CHECK_REBIND_FAIL 3
+#define DHCP_CHECK_REBIND_OK 4
+
+#endif /* FR12_HOST_DHCP_H */
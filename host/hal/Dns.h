@@ -0,0 +1,24 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Ethernet library's DNSClient. Every name resolves to
+// 127.0.0.1 unless FR12_HOST_DNS=fail is set in the environment.
+
+#ifndef FR12_HOST_DNS_H
+#define FR12_HOST_DNS_H
+
+#include "IPAddress.h"
+
+class DNSClient {
+public:
+  void begin(const IPAddress &dns_server) { this->dns_server = dns_server; }
+  int inet_aton(const char *address, IPAddress &result);
+  int getHostByName(const char *hostname, IPAddress &result);
+private:
+  IPAddress dns_server;
+};
+
+#endif /* FR12_HOST_DNS_H */
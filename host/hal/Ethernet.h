@@ -0,0 +1,42 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Arduino 1.0.x Ethernet library. DHCP always leases
+// 127.0.0.1 unless FR12_HOST_DHCP=fail is set in the environment.
+
+#ifndef FR12_HOST_ETHERNET_H
+#define FR12_HOST_ETHERNET_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "w5100.h"
+#include "Dhcp.h"
+#include "EthernetClient.h"
+#include "EthernetServer.h"
+
+class EthernetClass {
+public:
+  int begin(uint8_t *mac_address, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
+  void begin(uint8_t *mac_address, IPAddress local_ip);
+  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server);
+  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway);
+  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet);
+  int maintain();
+
+  IPAddress localIP();
+  IPAddress subnetMask();
+  IPAddress gatewayIP();
+  IPAddress dnsServerIP();
+
+  friend class EthernetClient;
+  friend class EthernetServer;
+private:
+  IPAddress local_ip, subnet, gateway, dns_server;
+};
+
+extern EthernetClass Ethernet;
+
+#endif /* FR12_HOST_ETHERNET_H */
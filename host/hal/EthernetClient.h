@@ -0,0 +1,46 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Arduino 1.0 EthernetClient. A client is a handle to
+// one of the MAX_SOCK_NUM simulated sockets, each backed by a loopback TCP
+// connection. Every write() call is counted as one SPI burst.
+
+#ifndef FR12_HOST_ETHERNETCLIENT_H
+#define FR12_HOST_ETHERNETCLIENT_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "w5100.h"
+
+class EthernetClient : public Stream {
+public:
+  EthernetClient();
+  EthernetClient(uint8_t sock);
+
+  uint8_t status();
+  int connect(IPAddress ip, uint16_t port);
+  virtual size_t write(uint8_t c);
+  virtual size_t write(const uint8_t *buf, size_t size);
+  virtual int available();
+  virtual int read();
+  virtual int read(uint8_t *buf, size_t size);
+  virtual int peek();
+  virtual void flush();
+  void stop();
+  uint8_t connected();
+  operator bool();
+
+  bool operator==(const EthernetClient &rhs) const { return this->sock == rhs.sock; }
+  bool operator!=(const EthernetClient &rhs) const { return this->sock != rhs.sock; }
+
+  using Print::write;
+
+  friend class EthernetServer;
+private:
+  uint8_t sock;
+};
+
+#endif /* FR12_HOST_ETHERNETCLIENT_H */
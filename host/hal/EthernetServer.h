@@ -0,0 +1,30 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Arduino 1.0 EthernetServer, listening on loopback.
+// The port is shifted by FR12_HOST_PORT_OFFSET so no privileges are needed.
+
+#ifndef FR12_HOST_ETHERNETSERVER_H
+#define FR12_HOST_ETHERNETSERVER_H
+
+#include "Arduino.h"
+#include "EthernetClient.h"
+
+class EthernetServer : public Print {
+public:
+  EthernetServer(uint16_t port);
+
+  void begin();
+  EthernetClient available();
+  virtual size_t write(uint8_t c);
+  virtual size_t write(const uint8_t *buf, size_t size);
+
+  using Print::write;
+private:
+  uint16_t port;
+};
+
+#endif /* FR12_HOST_ETHERNETSERVER_H */
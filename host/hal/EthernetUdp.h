@@ -0,0 +1,57 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Arduino 1.0 EthernetUDP. Datagrams go to loopback
+// whatever the destination address, with the port shifted like the server's.
+
+#ifndef FR12_HOST_ETHERNETUDP_H
+#define FR12_HOST_ETHERNETUDP_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "w5100.h"
+
+enum {
+  fr12_host_udp_tx_max = 548
+};
+
+class EthernetUDP : public Stream {
+public:
+  EthernetUDP();
+
+  uint8_t begin(uint16_t port);
+  void stop();
+
+  int beginPacket(IPAddress ip, uint16_t port);
+  int beginPacket(const char *host, uint16_t port);
+  int endPacket();
+  virtual size_t write(uint8_t c);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+
+  int parsePacket();
+  virtual int available();
+  virtual int read();
+  virtual int read(unsigned char *buffer, size_t len);
+  virtual int read(char *buffer, size_t len) { return this->read((unsigned char *)buffer, len); }
+  virtual int peek();
+  virtual void flush();
+
+  IPAddress remoteIP() { return this->remote_ip; }
+  uint16_t remotePort() { return this->remote_port; }
+
+  using Print::write;
+private:
+  uint8_t sock;
+  uint16_t port;
+  IPAddress remote_ip, tx_ip;
+  uint16_t remote_port, tx_port;
+  uint8_t tx[fr12_host_udp_tx_max];
+  size_t tx_len;
+  uint8_t rx[fr12_host_udp_tx_max];
+  size_t rx_len, rx_index;
+};
+
+#endif /* FR12_HOST_ETHERNETUDP_H */
@@ -0,0 +1,53 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Arduino 1.0 IPAddress class. Bytes are kept in
+// network order, so the uint32_t view matches the AVR's little-endian one.
+
+#ifndef FR12_HOST_IPADDRESS_H
+#define FR12_HOST_IPADDRESS_H
+
+#include <stdint.h>
+#include <string.h>
+
+class IPAddress {
+public:
+  IPAddress() { memset(this->address, 0, sizeof(this->address)); }
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    this->address[0] = a;
+    this->address[1] = b;
+    this->address[2] = c;
+    this->address[3] = d;
+  }
+  IPAddress(uint32_t address) { memcpy(this->address, &address, sizeof(this->address)); }
+  IPAddress(const uint8_t *address) { memcpy(this->address, address, sizeof(this->address)); }
+
+  operator uint32_t() const {
+    uint32_t a;
+    memcpy(&a, this->address, sizeof(a));
+    return a;
+  }
+  bool operator==(const IPAddress &addr) const { return memcmp(this->address, addr.address, sizeof(this->address)) == 0; }
+  bool operator==(const uint8_t *addr) const { return memcmp(this->address, addr, sizeof(this->address)) == 0; }
+
+  uint8_t operator[](int index) const { return this->address[index]; }
+  uint8_t &operator[](int index) { return this->address[index]; }
+
+  IPAddress &operator=(const uint8_t *address) {
+    memcpy(this->address, address, sizeof(this->address));
+    return *this;
+  }
+  IPAddress &operator=(uint32_t address) {
+    memcpy(this->address, &address, sizeof(this->address));
+    return *this;
+  }
+
+  const uint8_t *raw_address() const { return this->address; }
+private:
+  uint8_t address[4];
+};
+
+#endif /* FR12_HOST_IPADDRESS_H */
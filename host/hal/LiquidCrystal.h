@@ -0,0 +1,43 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the LiquidCrystal library. Characters land in an
+// in-memory HD44780 display buffer that fr12_host_lcd_dump() prints.
+
+#ifndef FR12_HOST_LIQUIDCRYSTAL_H
+#define FR12_HOST_LIQUIDCRYSTAL_H
+
+#include "Arduino.h"
+
+enum {
+  fr12_host_lcd_max_cols = 40,
+  fr12_host_lcd_max_rows = 4
+};
+
+class LiquidCrystal : public Print {
+public:
+  LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+  LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+  LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+  LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+  virtual ~LiquidCrystal();
+
+  void begin(uint8_t cols, uint8_t rows);
+  void clear();
+  void home();
+  void setCursor(uint8_t col, uint8_t row);
+  virtual size_t write(uint8_t c);
+
+  using Print::write;
+
+  // Display contents, one row per line
+  char text[fr12_host_lcd_max_rows][fr12_host_lcd_max_cols + 1];
+  uint8_t cols, rows;
+private:
+  uint8_t col, row;
+};
+
+#endif /* FR12_HOST_LIQUIDCRYSTAL_H */
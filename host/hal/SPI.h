@@ -0,0 +1,20 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the SPI library. The simulated W5100 has no bus.
+
+#ifndef FR12_HOST_SPI_H
+#define FR12_HOST_SPI_H
+
+class SPIClass {
+public:
+  static void begin() {}
+  static void end() {}
+};
+
+extern SPIClass SPI;
+
+#endif /* FR12_HOST_SPI_H */
@@ -0,0 +1,384 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "Arduino.h"
+#include "fr12_host.h"
+
+#include <stdio.h>
+#include <time.h>
+
+// Registers
+volatile uint8_t PORTB = 0;
+volatile uint8_t DDRB = 0;
+volatile uint8_t EECR = 0;
+volatile uint8_t SREG = (1 << SREG_I);
+volatile uint8_t TCCR1A = 0;
+volatile uint8_t TCCR1B = 0;
+volatile uint8_t TIMSK1 = 0;
+volatile uint16_t OCR1A = 0;
+
+// Counters
+fr12_host_stats fr12_host_counters;
+
+// Clock state
+static uint8_t clock_mode = fr12_host_clock_real;
+static int64_t clock_offset = 0;
+static uint64_t clock_virtual = 0;
+static uint32_t clock_step = 10;
+
+// Pin state
+static uint8_t pin_inputs[256];
+static uint8_t pin_outputs[256];
+
+// Reset hook
+static void (*reset_hook)() = NULL;
+
+// Timer1: when the next compare match is due (simulated ns), 0 if stopped
+static uint64_t timer1_next = 0;
+
+// TIMER1_COMPA vector, if the firmware has one
+extern "C" void TIMER1_COMPA_vect() __attribute__((weak));
+
+uint64_t fr12_host_wall_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void fr12_host_clock_mode(uint8_t mode) {
+  uint64_t now = fr12_host_clock_us();
+  clock_mode = mode;
+  fr12_host_clock_set(now);
+}
+
+void fr12_host_clock_set(uint64_t us) {
+  clock_virtual = us;
+  clock_offset = (int64_t)us - (int64_t)fr12_host_wall_us();
+}
+
+void fr12_host_clock_advance(uint64_t us) {
+  clock_virtual += us;
+  clock_offset += us;
+}
+
+void fr12_host_clock_poll_step(uint32_t us) {
+  clock_step = us;
+}
+
+uint64_t fr12_host_clock_us() {
+  if (clock_mode == fr12_host_clock_virtual) {
+    return clock_virtual;
+  }
+
+  return fr12_host_wall_us() + clock_offset;
+}
+
+// Every read of the virtual clock by the firmware nudges it forward so
+// busy-waits finish, and gives pending interrupts a chance to run
+uint64_t fr12_host_clock_poll() {
+  uint64_t now = fr12_host_clock_us();
+  if (clock_mode == fr12_host_clock_virtual) {
+    clock_virtual += clock_step;
+  }
+  fr12_host_interrupts();
+  return now;
+}
+
+void fr12_host_interrupts() {
+  if (!(SREG & (1 << SREG_I))) {
+    return;
+  }
+
+  // Vectors run with interrupts off, as on the AVR
+  cli();
+  fr12_host_eeprom_interrupt();
+  fr12_host_timer1_interrupt();
+  sei();
+}
+
+// Runs every compare match that came due since the last poll. The real
+// timer keeps counting through delay() and the like, so none are dropped.
+void fr12_host_timer1_interrupt() {
+  static const uint16_t prescale[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+  uint16_t div = prescale[TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))];
+
+  if (!(TIMSK1 & _BV(OCIE1A)) || !(TCCR1B & _BV(WGM12)) || div == 0 || TIMER1_COMPA_vect == NULL) {
+    timer1_next = 0;
+    return;
+  }
+
+  uint64_t period = (uint64_t)(OCR1A + 1) * div * 1000000000ULL / F_CPU;
+  uint64_t now = fr12_host_clock_us() * 1000;
+  if (timer1_next == 0) {
+    timer1_next = now + period;
+    return;
+  }
+
+  while (now >= timer1_next) {
+    TIMER1_COMPA_vect();
+    timer1_next += period;
+  }
+}
+
+uint32_t millis() {
+  return (uint32_t)(fr12_host_clock_poll() / 1000);
+}
+
+uint32_t micros() {
+  return (uint32_t)fr12_host_clock_poll();
+}
+
+void delay(unsigned long ms) {
+  delayMicroseconds(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  if (clock_mode == fr12_host_clock_virtual) {
+    clock_virtual += us;
+    return;
+  }
+
+  struct timespec ts;
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000L;
+  nanosleep(&ts, NULL);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  // Digital 13 is PB7 on the Mega
+  if (pin == 13) {
+    if (mode == OUTPUT) {
+      DDRB |= _BV(PB7);
+    } else {
+      DDRB &= ~_BV(PB7);
+    }
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin == 13) {
+    if (val) {
+      PORTB |= _BV(PB7);
+    } else {
+      PORTB &= ~_BV(PB7);
+    }
+  }
+  pin_outputs[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+  return pin_inputs[pin] ? HIGH : LOW;
+}
+
+void analogWrite(uint8_t pin, int val) {
+  pin_outputs[pin] = (uint8_t)val;
+}
+
+void fr12_host_pin_input(uint8_t pin, uint8_t value) {
+  pin_inputs[pin] = value;
+}
+
+uint8_t fr12_host_pin_output(uint8_t pin) {
+  if (pin == 13) {
+    return (PORTB & _BV(PB7)) ? HIGH : LOW;
+  }
+  return pin_outputs[pin];
+}
+
+void fr12_host_reset_hook(void (*hook)()) {
+  reset_hook = hook;
+}
+
+void fr12_host_reset() {
+  fr12_host_net_close_all();
+  if (reset_hook != NULL) {
+    reset_hook();
+  }
+
+  fprintf(stderr, "fr12-host: reset requested with no hook installed\n");
+  exit(1);
+}
+
+void fr12_host_stats_get(fr12_host_stats *stats) {
+  *stats = fr12_host_counters;
+}
+
+void fr12_host_stats_clear() {
+  memset(&fr12_host_counters, 0, sizeof(fr12_host_counters));
+  fr12_host_eeprom_clear_wear();
+}
+
+// Drops 'l' length modifiers from an AVR format string ("long" is 32 bits)
+static const char *format_translate(const char *fmt, char *buf, size_t len) {
+  size_t o = 0;
+  uint8_t in_spec = 0;
+
+  for (const char *p = fmt; *p != '\0'; p++) {
+    if (o + 1 >= len) {
+      return fmt;
+    }
+
+    if (in_spec) {
+      if (*p == 'l') {
+        continue;
+      }
+      if (strchr("diouxXcspfeEgGn%[", *p) != NULL) {
+        in_spec = 0;
+      }
+    }
+    else if (*p == '%') {
+      in_spec = 1;
+    }
+    buf[o++] = *p;
+  }
+
+  buf[o] = '\0';
+  return buf;
+}
+
+int vsnprintf_P(char *s, size_t n, const char *fmt, va_list ap) {
+  char buf[256];
+  return vsnprintf(s, n, format_translate(fmt, buf, sizeof(buf)), ap);
+}
+
+int snprintf_P(char *s, size_t n, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int ret = vsnprintf_P(s, n, fmt, ap);
+  va_end(ap);
+  return ret;
+}
+
+int sprintf_P(char *s, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int ret = vsnprintf_P(s, 0xffff, fmt, ap);
+  va_end(ap);
+  return ret;
+}
+
+int sscanf_P(const char *s, const char *fmt, ...) {
+  char buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int ret = vsscanf(s, format_translate(fmt, buf, sizeof(buf)), ap);
+  va_end(ap);
+  return ret;
+}
+
+// Print
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += this->write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *s) {
+  const char *p = (const char *)s;
+  size_t n = 0;
+  while (*p != '\0') {
+    n += this->write((uint8_t)*p++);
+  }
+  return n;
+}
+
+size_t Print::print(const char *s) {
+  return this->write(s);
+}
+
+size_t Print::print(char c) {
+  return this->write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base) {
+  return this->print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base) {
+  return this->print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+  return this->print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base) {
+  if (base == 10 && n < 0) {
+    size_t t = this->print('-');
+    return t + this->print_number((unsigned long)-n, 10);
+  }
+  return this->print_number((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  return this->print_number(n, base);
+}
+
+size_t Print::println(const __FlashStringHelper *s) {
+  size_t n = this->print(s);
+  return n + this->println();
+}
+
+size_t Print::println(const char *s) {
+  size_t n = this->print(s);
+  return n + this->println();
+}
+
+size_t Print::println(char c) {
+  size_t n = this->print(c);
+  return n + this->println();
+}
+
+size_t Print::println(unsigned char b, int base) {
+  size_t n = this->print(b, base);
+  return n + this->println();
+}
+
+size_t Print::println(int num, int base) {
+  size_t n = this->print(num, base);
+  return n + this->println();
+}
+
+size_t Print::println(unsigned int num, int base) {
+  size_t n = this->print(num, base);
+  return n + this->println();
+}
+
+size_t Print::println(long num, int base) {
+  size_t n = this->print(num, base);
+  return n + this->println();
+}
+
+size_t Print::println(unsigned long num, int base) {
+  size_t n = this->print(num, base);
+  return n + this->println();
+}
+
+size_t Print::println() {
+  size_t n = this->print('\r');
+  return n + this->print('\n');
+}
+
+size_t Print::print_number(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+
+  *str = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+
+  do {
+    unsigned long m = n;
+    n /= base;
+    char c = m - base * n;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+
+  return this->write(str);
+}
@@ -0,0 +1,38 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for avr-libc's <avr/eeprom.h>, backed by a 4 KB image file.
+// Writes follow the ATmega2560 timing: each byte takes about 3.3 ms and a
+// write issued while the previous one is still programming waits for it.
+
+#ifndef FR12_HOST_AVR_EEPROM_H
+#define FR12_HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define E2END 0x0FFF
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+uint16_t eeprom_read_word(const uint16_t *addr);
+uint32_t eeprom_read_dword(const uint32_t *addr);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_write_word(uint16_t *addr, uint16_t value);
+void eeprom_write_dword(uint32_t *addr, uint32_t value);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+int eeprom_is_ready();
+#define eeprom_busy_wait() do {} while (!eeprom_is_ready())
+
+#define _EEGET(var, addr) (var) = eeprom_read_byte((const uint8_t *)(uintptr_t)(addr))
+#define _EEPUT(addr, val) eeprom_write_byte((uint8_t *)(uintptr_t)(addr), (uint8_t)(val))
+
+#endif /* FR12_HOST_AVR_EEPROM_H */
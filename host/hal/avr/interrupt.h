@@ -0,0 +1,25 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for <avr/interrupt.h>. There is only one thread of
+// execution: the HAL runs a pending vector whenever the firmware reads the
+// clock with interrupts enabled, and clears the I flag while it runs.
+
+#ifndef FR12_HOST_AVR_INTERRUPT_H
+#define FR12_HOST_AVR_INTERRUPT_H
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+
+#define SREG_I 7
+
+#define sei() (SREG |= (1 << SREG_I))
+#define cli() (SREG &= ~(1 << SREG_I))
+
+#define ISR(vector) extern "C" void vector(); void vector()
+
+#endif /* FR12_HOST_AVR_INTERRUPT_H */
@@ -0,0 +1,40 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for <avr/io.h>. Registers are plain variables.
+
+#ifndef FR12_HOST_AVR_IO_H
+#define FR12_HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#include <avr/interrupt.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t PORTB;
+extern volatile uint8_t DDRB;
+extern volatile uint8_t EECR;
+
+// Timer1, modelled in CTC mode on OCR1A only
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TIMSK1;
+extern volatile uint16_t OCR1A;
+
+#define PB7 7
+#define EERIE 3
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define OCIE1A 1
+
+// Interrupt vectors the HAL can raise
+#define EE_READY_vect fr12_host_vector_ee_ready
+#define TIMER1_COMPA_vect fr12_host_vector_timer1_compa
+
+#endif /* FR12_HOST_AVR_IO_H */
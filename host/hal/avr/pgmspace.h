@@ -0,0 +1,57 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for avr-libc's <avr/pgmspace.h>. Flash and RAM share one
+// address space here, so the _P routines are thin wrappers. The printf and
+// scanf families translate AVR format strings first: "long" is 32 bits on
+// the AVR, which is "int" on the host.
+
+#ifndef FR12_HOST_AVR_PGMSPACE_H
+#define FR12_HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PGM_VOID_P const void *
+#define PSTR(s) ((const char *)(s))
+
+typedef char prog_char;
+typedef unsigned char prog_uchar;
+typedef uint8_t prog_uint8_t;
+typedef uint16_t prog_uint16_t;
+typedef uint32_t prog_uint32_t;
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+// Words double as near pointers on the AVR, so keep the pointee type
+template <typename T> static inline T fr12_host_pgm_read_word(const T *addr) { return *addr; }
+static inline uint16_t fr12_host_pgm_read_word(const void *addr) { return *(const uint16_t *)addr; }
+#define pgm_read_word(addr) fr12_host_pgm_read_word(addr)
+#define pgm_read_ptr(addr) fr12_host_pgm_read_word(addr)
+
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+#define strncasecmp_P strncasecmp
+#define strstr_P strstr
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+
+int vsnprintf_P(char *s, size_t n, const char *fmt, va_list ap);
+int snprintf_P(char *s, size_t n, const char *fmt, ...);
+int sprintf_P(char *s, const char *fmt, ...);
+int sscanf_P(const char *s, const char *fmt, ...);
+
+#endif /* FR12_HOST_AVR_PGMSPACE_H */
@@ -0,0 +1,18 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for <avr/sleep.h>. Sleeping returns at once; the harness
+// moves the clock on between loop() calls.
+
+#ifndef FR12_HOST_AVR_SLEEP_H
+#define FR12_HOST_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE 0
+
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_mode() ((void)0)
+
+#endif /* FR12_HOST_AVR_SLEEP_H */
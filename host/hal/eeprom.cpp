@@ -0,0 +1,170 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "Arduino.h"
+#include "fr12_host.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Image, backing file and per-cell write counts
+static uint8_t image[fr12_host_eeprom_size];
+static uint32_t wear[fr12_host_eeprom_size];
+static int image_fd = -1;
+static uint8_t image_loaded = 0;
+
+// Simulated time at which the current write finishes programming
+static uint64_t busy_until = 0;
+
+// EE_READY vector, if the firmware has one
+extern "C" void EE_READY_vect() __attribute__((weak));
+
+static void eeprom_load() {
+  if (image_loaded) {
+    return;
+  }
+
+  // Erased cells read back as 0xff
+  memset(image, 0xff, sizeof(image));
+  if (image_fd >= 0) {
+    ssize_t n = pread(image_fd, image, sizeof(image), 0);
+    if (n < 0) {
+      perror("fr12-host: eeprom read");
+    }
+
+    // Fill out a new or short file, or skipped 0xff cells read back as 0
+    else if ((size_t)n < sizeof(image) && pwrite(image_fd, image + n, sizeof(image) - n, n) != (ssize_t)(sizeof(image) - n)) {
+      perror("fr12-host: eeprom write");
+    }
+  }
+  image_loaded = 1;
+}
+
+static size_t eeprom_addr(const void *addr) {
+  return (uintptr_t)addr % fr12_host_eeprom_size;
+}
+
+int fr12_host_eeprom_open(const char *path) {
+  fr12_host_eeprom_close();
+  image_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (image_fd < 0) {
+    perror("fr12-host: eeprom open");
+    return -1;
+  }
+  eeprom_load();
+  return 0;
+}
+
+void fr12_host_eeprom_close() {
+  if (image_fd >= 0) {
+    close(image_fd);
+  }
+  image_fd = -1;
+  image_loaded = 0;
+}
+
+void fr12_host_eeprom_clear_wear() {
+  memset(wear, 0, sizeof(wear));
+}
+
+uint32_t fr12_host_eeprom_wear(size_t offset, size_t len) {
+  uint32_t writes = 0;
+  for (size_t a = offset; a < offset + len && a < fr12_host_eeprom_size; a++) {
+    writes += wear[a];
+  }
+  return writes;
+}
+
+// Lets the simulated clock run until the current write finishes
+static void eeprom_wait() {
+  uint64_t now = fr12_host_clock_us();
+  if (now < busy_until) {
+    delayMicroseconds(busy_until - now);
+  }
+}
+
+int eeprom_is_ready() {
+  return fr12_host_clock_poll() >= busy_until;
+}
+
+// EE_READY is level-triggered: it fires whenever it's enabled and no write
+// is programming
+void fr12_host_eeprom_interrupt() {
+  if ((EECR & _BV(EERIE)) && EE_READY_vect != NULL && fr12_host_clock_us() >= busy_until) {
+    EE_READY_vect();
+  }
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+  eeprom_load();
+  eeprom_wait();
+  fr12_host_counters.eeprom_reads++;
+  return image[eeprom_addr(addr)];
+}
+
+uint16_t eeprom_read_word(const uint16_t *addr) {
+  uint16_t w;
+  eeprom_read_block(&w, addr, sizeof(w));
+  return w;
+}
+
+uint32_t eeprom_read_dword(const uint32_t *addr) {
+  uint32_t d;
+  eeprom_read_block(&d, addr, sizeof(d));
+  return d;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+  for (size_t a = 0; a < n; a++) {
+    ((uint8_t *)dst)[a] = eeprom_read_byte((const uint8_t *)src + a);
+  }
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value) {
+  size_t a = eeprom_addr(addr);
+
+  eeprom_load();
+
+  // Wait out the previous write, then start this one
+  eeprom_wait();
+  busy_until = fr12_host_clock_us() + fr12_host_eeprom_write_us;
+
+  image[a] = value;
+  if (image_fd >= 0 && pwrite(image_fd, &value, 1, a) != 1) {
+    perror("fr12-host: eeprom write");
+  }
+
+  fr12_host_counters.eeprom_writes++;
+  if (++wear[a] > fr12_host_counters.eeprom_max_cell_writes) {
+    fr12_host_counters.eeprom_max_cell_writes = wear[a];
+  }
+}
+
+void eeprom_write_word(uint16_t *addr, uint16_t value) {
+  eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_dword(uint32_t *addr, uint32_t value) {
+  eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n) {
+  for (size_t a = 0; a < n; a++) {
+    eeprom_write_byte((uint8_t *)dst + a, ((const uint8_t *)src)[a]);
+  }
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+  if (eeprom_read_byte(addr) != value) {
+    eeprom_write_byte(addr, value);
+  }
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+  for (size_t a = 0; a < n; a++) {
+    eeprom_update_byte((uint8_t *)dst + a, ((const uint8_t *)src)[a]);
+  }
+}
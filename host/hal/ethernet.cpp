@@ -0,0 +1,751 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "Ethernet.h"
+#include "EthernetUdp.h"
+#include "Dns.h"
+#include "SPI.h"
+#include "fr12_host.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+SPIClass SPI;
+EthernetClass Ethernet;
+
+// Simulated W5100 sockets
+enum {
+  host_socket_free = 0,
+  host_socket_listen,
+  host_socket_tcp,
+  host_socket_udp
+};
+
+struct host_socket {
+  uint8_t kind;
+  int fd;
+  uint16_t port;
+};
+
+// Kernel listening sockets, one per server port
+struct host_listener {
+  uint16_t port;
+  int fd;
+};
+
+static host_socket sockets[MAX_SOCK_NUM];
+static host_listener listeners[MAX_SOCK_NUM];
+static uint8_t sockets_ready = 0;
+static int port_offset = -1;
+
+// NTP servers, one at each of 127.0.0.1 on. FR12_HOST_NTP_SERVERS lists
+// how far (ms) each one's clock is off, or "-" for one that never answers;
+// by default there's one, and it's right.
+enum {
+  host_ntp_servers = 4
+};
+
+struct host_ntp_server {
+  int fd;
+  int32_t offset_ms;
+};
+
+static host_ntp_server ntp_servers[host_ntp_servers];
+static uint8_t ntp_server_count = 0;
+
+// The NTP servers' clock: the wall clock when the responder started, run
+// forward at the simulated clock's rate, skewed by FR12_HOST_NTP_PPM
+static struct timespec ntp_base;
+static uint64_t ntp_base_us;
+static double ntp_ppm;
+
+static void sockets_init() {
+  if (sockets_ready) {
+    return;
+  }
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) {
+    sockets[s].kind = host_socket_free;
+    sockets[s].fd = -1;
+    sockets[s].port = 0;
+    listeners[s].port = 0;
+    listeners[s].fd = -1;
+  }
+  sockets_ready = 1;
+}
+
+static uint8_t socket_alloc(uint8_t kind, uint16_t port) {
+  sockets_init();
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) {
+    if (sockets[s].kind == host_socket_free) {
+      sockets[s].kind = kind;
+      sockets[s].fd = -1;
+      sockets[s].port = port;
+      return s;
+    }
+  }
+  return MAX_SOCK_NUM;
+}
+
+static void socket_free(uint8_t s) {
+  if (sockets[s].fd >= 0) {
+    close(sockets[s].fd);
+  }
+  sockets[s].kind = host_socket_free;
+  sockets[s].fd = -1;
+  sockets[s].port = 0;
+}
+
+static void loopback(struct sockaddr_in *sa, uint16_t port) {
+  memset(sa, 0, sizeof(*sa));
+  sa->sin_family = AF_INET;
+  sa->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa->sin_port = htons(fr12_host_net_port(port));
+}
+
+// The same, at an address in 127.0.0.0/8. Anywhere else is 127.0.0.1.
+static void loopback_at(struct sockaddr_in *sa, IPAddress ip, uint16_t port) {
+  loopback(sa, port);
+  if (ip[0] == 127) {
+    sa->sin_addr.s_addr = htonl((uint32_t)ip[0] << 24 | (uint32_t)ip[1] << 16 | (uint32_t)ip[2] << 8 | ip[3]);
+  }
+}
+
+static int listener_fd(uint16_t port) {
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) {
+    if (listeners[s].fd >= 0 && listeners[s].port == port) {
+      return listeners[s].fd;
+    }
+  }
+  return -1;
+}
+
+// A LISTEN socket turns into an ESTABLISHED one as soon as a peer connects
+static void socket_try_accept(uint8_t s) {
+  int lfd = listener_fd(sockets[s].port);
+  if (lfd < 0) {
+    return;
+  }
+
+  int fd = accept(lfd, NULL, NULL);
+  if (fd < 0) {
+    return;
+  }
+
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  sockets[s].kind = host_socket_tcp;
+  sockets[s].fd = fd;
+  fr12_host_counters.eth_accepts++;
+}
+
+void fr12_host_net_port_offset(uint16_t offset) {
+  port_offset = offset;
+}
+
+uint16_t fr12_host_net_port(uint16_t port) {
+  if (port_offset < 0) {
+    const char *env = getenv("FR12_HOST_PORT_OFFSET");
+    port_offset = env != NULL ? atoi(env) : 8000;
+  }
+  return (uint16_t)(port + port_offset);
+}
+
+void fr12_host_net_close_all() {
+  sockets_init();
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) {
+    socket_free(s);
+    if (listeners[s].fd >= 0) {
+      close(listeners[s].fd);
+    }
+    listeners[s].fd = -1;
+    listeners[s].port = 0;
+  }
+}
+
+// Built-in SNTP servers on the shifted NTP port
+int fr12_host_ntp_responder(int enable) {
+  for (uint8_t a = 0; a < ntp_server_count; a++) {
+    if (ntp_servers[a].fd >= 0) {
+      close(ntp_servers[a].fd);
+    }
+  }
+  ntp_server_count = 0;
+  if (!enable) {
+    return 0;
+  }
+
+  const char *env = getenv("FR12_HOST_NTP_PPM"), *servers = getenv("FR12_HOST_NTP_SERVERS");
+  clock_gettime(CLOCK_REALTIME, &ntp_base);
+  ntp_base_us = fr12_host_clock_us();
+  ntp_ppm = env != NULL ? atof(env) : 0.0;
+
+  for (const char *p = servers != NULL ? servers : "0"; ntp_server_count < host_ntp_servers; p++) {
+    host_ntp_server *server = &ntp_servers[ntp_server_count];
+    struct sockaddr_in sa;
+
+    // Silent servers still take their address, so nothing else answers
+    server->fd = -1;
+    server->offset_ms = strtol(p, NULL, 10);
+    if (*p != '-' || (p[1] >= '0' && p[1] <= '9')) {
+      loopback_at(&sa, IPAddress(127, 0, 0, ntp_server_count + 1), 123);
+      server->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+      if (server->fd < 0 || bind(server->fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        perror("fr12-host: ntp responder");
+        return -1;
+      }
+    }
+    ntp_server_count++;
+
+    if ((p = strchr(p, ',')) == NULL) {
+      break;
+    }
+  }
+  return 0;
+}
+
+static void ntp_timestamp(uint8_t *p, const struct timespec *ts) {
+  uint32_t secs = (uint32_t)(ts->tv_sec + 2208988800ULL);
+  uint32_t frac = (uint32_t)(((uint64_t)ts->tv_nsec << 32) / 1000000000ULL);
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = (uint8_t)(secs >> (24 - 8 * i));
+    p[4 + i] = (uint8_t)(frac >> (24 - 8 * i));
+  }
+}
+
+static void ntp_service() {
+  uint8_t packet[48];
+  struct sockaddr_in from;
+  socklen_t from_len = sizeof(from);
+  ssize_t n;
+
+  for (uint8_t a = 0; a < ntp_server_count; a++) {
+    host_ntp_server *server = &ntp_servers[a];
+    if (server->fd < 0) {
+      continue;
+    }
+
+    while ((n = recvfrom(server->fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len)) == (ssize_t)sizeof(packet)) {
+      struct timespec now = ntp_base;
+      int64_t elapsed_ns = (int64_t)((double)(fr12_host_clock_us() - ntp_base_us) * 1000.0 * (1.0 + ntp_ppm / 1e6)) + (int64_t)server->offset_ms * 1000000;
+      now.tv_sec += elapsed_ns / 1000000000LL;
+      now.tv_nsec += elapsed_ns % 1000000000LL;
+      if (now.tv_nsec >= 1000000000L) {
+        now.tv_sec++;
+        now.tv_nsec -= 1000000000L;
+      }
+      else if (now.tv_nsec < 0) {
+        now.tv_sec--;
+        now.tv_nsec += 1000000000L;
+      }
+
+      // Originate is the client's transmit timestamp
+      memcpy(&packet[24], &packet[40], 8);
+      packet[0] = 0x24; // LI 0, version 4, server
+      packet[1] = 1;    // Stratum
+      packet[3] = 0xEC; // Precision
+      memset(&packet[4], 0, 8);
+      memcpy(&packet[12], "HOST", 4);
+      ntp_timestamp(&packet[16], &now);
+      ntp_timestamp(&packet[32], &now);
+      ntp_timestamp(&packet[40], &now);
+      sendto(server->fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, from_len);
+      from_len = sizeof(from);
+    }
+  }
+}
+
+// EthernetClass
+int EthernetClass::begin(uint8_t *mac_address, unsigned long timeout, unsigned long responseTimeout) {
+  const char *env = getenv("FR12_HOST_DHCP");
+
+  // The real library gives up after the timeout (60 seconds by default)
+  if (env != NULL && strcmp(env, "fail") == 0) {
+    delay(timeout);
+    return 0;
+  }
+
+  this->local_ip = IPAddress(127, 0, 0, 1);
+  this->dns_server = IPAddress(127, 0, 0, 1);
+  this->gateway = IPAddress(127, 0, 0, 1);
+  this->subnet = IPAddress(255, 0, 0, 0);
+  return 1;
+}
+
+void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip) {
+  IPAddress dns_server = local_ip;
+  dns_server[3] = 1;
+  this->begin(mac_address, local_ip, dns_server);
+}
+
+void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server) {
+  IPAddress gateway = local_ip;
+  gateway[3] = 1;
+  this->begin(mac_address, local_ip, dns_server, gateway);
+}
+
+void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway) {
+  this->begin(mac_address, local_ip, dns_server, gateway, IPAddress(255, 255, 255, 0));
+}
+
+void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet) {
+  this->local_ip = local_ip;
+  this->dns_server = dns_server;
+  this->gateway = gateway;
+  this->subnet = subnet;
+}
+
+int EthernetClass::maintain() {
+  return DHCP_CHECK_NONE;
+}
+
+IPAddress EthernetClass::localIP() {
+  return this->local_ip;
+}
+
+IPAddress EthernetClass::subnetMask() {
+  return this->subnet;
+}
+
+IPAddress EthernetClass::gatewayIP() {
+  return this->gateway;
+}
+
+IPAddress EthernetClass::dnsServerIP() {
+  return this->dns_server;
+}
+
+// EthernetClient
+EthernetClient::EthernetClient() : sock(MAX_SOCK_NUM) {
+}
+
+EthernetClient::EthernetClient(uint8_t sock) : sock(sock) {
+}
+
+uint8_t EthernetClient::status() {
+  if (this->sock >= MAX_SOCK_NUM) {
+    return SnSR::CLOSED;
+  }
+
+  host_socket *s = &sockets[this->sock];
+  switch (s->kind) {
+  case host_socket_listen:
+    socket_try_accept(this->sock);
+    return s->kind == host_socket_tcp ? SnSR::ESTABLISHED : SnSR::LISTEN;
+  case host_socket_udp:
+    return SnSR::UDP;
+  case host_socket_tcp: {
+    int pending = 0;
+    if (ioctl(s->fd, FIONREAD, &pending) == 0 && pending > 0) {
+      return SnSR::ESTABLISHED;
+    }
+
+    uint8_t c;
+    ssize_t n = recv(s->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0) {
+      return SnSR::CLOSE_WAIT;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      return SnSR::CLOSED;
+    }
+    return SnSR::ESTABLISHED;
+  }
+  default:
+    return SnSR::CLOSED;
+  }
+}
+
+int EthernetClient::connect(IPAddress ip, uint16_t port) {
+  if (this->sock != MAX_SOCK_NUM) {
+    return 0;
+  }
+
+  this->sock = socket_alloc(host_socket_tcp, 0);
+  if (this->sock == MAX_SOCK_NUM) {
+    return 0;
+  }
+
+  struct sockaddr_in sa;
+  loopback(&sa, port);
+  sockets[this->sock].fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (sockets[this->sock].fd < 0 || ::connect(sockets[this->sock].fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    socket_free(this->sock);
+    this->sock = MAX_SOCK_NUM;
+    return 0;
+  }
+  return 1;
+}
+
+size_t EthernetClient::write(uint8_t c) {
+  return this->write(&c, 1);
+}
+
+size_t EthernetClient::write(const uint8_t *buf, size_t size) {
+  if (this->sock >= MAX_SOCK_NUM || sockets[this->sock].kind != host_socket_tcp) {
+    return 0;
+  }
+
+  fr12_host_counters.eth_write_calls++;
+
+  size_t sent = 0;
+  while (sent < size) {
+    ssize_t n = send(sockets[this->sock].fd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      break;
+    }
+    sent += n;
+  }
+
+  fr12_host_counters.eth_write_bytes += sent;
+  return sent;
+}
+
+int EthernetClient::available() {
+  if (this->sock >= MAX_SOCK_NUM || sockets[this->sock].kind != host_socket_tcp) {
+    return 0;
+  }
+
+  fr12_host_counters.eth_read_calls++;
+
+  int pending = 0;
+  if (ioctl(sockets[this->sock].fd, FIONREAD, &pending) < 0) {
+    return 0;
+  }
+  return pending;
+}
+
+int EthernetClient::read() {
+  uint8_t c;
+  if (this->read(&c, 1) > 0) {
+    return c;
+  }
+  return -1;
+}
+
+int EthernetClient::read(uint8_t *buf, size_t size) {
+  if (this->sock >= MAX_SOCK_NUM || sockets[this->sock].kind != host_socket_tcp) {
+    return 0;
+  }
+
+  fr12_host_counters.eth_read_calls++;
+
+  ssize_t n = recv(sockets[this->sock].fd, buf, size, MSG_DONTWAIT);
+  if (n < 0) {
+    return -1;
+  }
+  return (int)n;
+}
+
+int EthernetClient::peek() {
+  if (this->sock >= MAX_SOCK_NUM || sockets[this->sock].kind != host_socket_tcp) {
+    return -1;
+  }
+
+  uint8_t c;
+  if (recv(sockets[this->sock].fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1) {
+    return c;
+  }
+  return -1;
+}
+
+void EthernetClient::flush() {
+  // Arduino 1.0 discards unread input here
+  while (this->available()) {
+    this->read();
+  }
+}
+
+void EthernetClient::stop() {
+  if (this->sock >= MAX_SOCK_NUM) {
+    return;
+  }
+
+  if (sockets[this->sock].kind == host_socket_tcp) {
+    shutdown(sockets[this->sock].fd, SHUT_RDWR);
+    socket_free(this->sock);
+  }
+  this->sock = MAX_SOCK_NUM;
+}
+
+uint8_t EthernetClient::connected() {
+  if (this->sock >= MAX_SOCK_NUM) {
+    return 0;
+  }
+
+  uint8_t s = this->status();
+  return !(s == SnSR::LISTEN || s == SnSR::CLOSED || (s == SnSR::CLOSE_WAIT && !this->available()));
+}
+
+EthernetClient::operator bool() {
+  return this->sock != MAX_SOCK_NUM;
+}
+
+// EthernetServer
+EthernetServer::EthernetServer(uint16_t port) : port(port) {
+}
+
+void EthernetServer::begin() {
+  sockets_init();
+
+  if (listener_fd(this->port) < 0) {
+    struct sockaddr_in sa;
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+    loopback(&sa, this->port);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, 8) < 0) {
+      perror("fr12-host: http listen");
+      if (fd >= 0) {
+        close(fd);
+      }
+      return;
+    }
+
+    for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) {
+      if (listeners[s].fd < 0) {
+        listeners[s].fd = fd;
+        listeners[s].port = this->port;
+        break;
+      }
+    }
+  }
+
+  // Take a hardware socket to listen on
+  socket_alloc(host_socket_listen, this->port);
+}
+
+EthernetClient EthernetServer::available() {
+  uint8_t listening = 0;
+
+  // Like the library's accept(): reap closed sockets and keep one listening
+  for (uint8_t sock = 0; sock < MAX_SOCK_NUM; sock++) {
+    EthernetClient client(sock);
+    if (sockets[sock].port == this->port && sockets[sock].kind != host_socket_free) {
+      uint8_t s = client.status();
+      if (s == SnSR::LISTEN) {
+        listening = 1;
+      }
+      else if (s == SnSR::CLOSE_WAIT && !client.available()) {
+        client.stop();
+      }
+    }
+  }
+
+  if (!listening) {
+    this->begin();
+  }
+
+  for (uint8_t sock = 0; sock < MAX_SOCK_NUM; sock++) {
+    EthernetClient client(sock);
+    if (sockets[sock].port == this->port && sockets[sock].kind == host_socket_tcp) {
+      uint8_t s = client.status();
+      if (s == SnSR::ESTABLISHED || s == SnSR::CLOSE_WAIT) {
+        if (client.available()) {
+          return client;
+        }
+      }
+    }
+  }
+
+  return EthernetClient(MAX_SOCK_NUM);
+}
+
+size_t EthernetServer::write(uint8_t c) {
+  return this->write(&c, 1);
+}
+
+size_t EthernetServer::write(const uint8_t *buf, size_t size) {
+  size_t n = 0;
+  for (uint8_t sock = 0; sock < MAX_SOCK_NUM; sock++) {
+    EthernetClient client(sock);
+    if (sockets[sock].port == this->port && sockets[sock].kind == host_socket_tcp) {
+      n += client.write(buf, size);
+    }
+  }
+  return n;
+}
+
+// EthernetUDP
+EthernetUDP::EthernetUDP() : sock(MAX_SOCK_NUM), port(0), remote_port(0), tx_port(0), tx_len(0), rx_len(0), rx_index(0) {
+}
+
+uint8_t EthernetUDP::begin(uint16_t port) {
+  if (this->sock != MAX_SOCK_NUM) {
+    return 0;
+  }
+
+  this->sock = socket_alloc(host_socket_udp, port);
+  if (this->sock == MAX_SOCK_NUM) {
+    return 0;
+  }
+
+  struct sockaddr_in sa;
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  loopback(&sa, port);
+  if (fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    perror("fr12-host: udp bind");
+    if (fd >= 0) {
+      close(fd);
+    }
+    socket_free(this->sock);
+    this->sock = MAX_SOCK_NUM;
+    return 0;
+  }
+
+  sockets[this->sock].fd = fd;
+  this->port = port;
+  return 1;
+}
+
+void EthernetUDP::stop() {
+  if (this->sock < MAX_SOCK_NUM && sockets[this->sock].kind == host_socket_udp) {
+    socket_free(this->sock);
+  }
+  this->sock = MAX_SOCK_NUM;
+}
+
+int EthernetUDP::beginPacket(IPAddress ip, uint16_t port) {
+  this->tx_ip = ip;
+  this->tx_port = port;
+  this->tx_len = 0;
+  return 1;
+}
+
+int EthernetUDP::beginPacket(const char *host, uint16_t port) {
+  DNSClient dns;
+  IPAddress ip;
+  dns.begin(Ethernet.dnsServerIP());
+  if (dns.getHostByName(host, ip) != 1) {
+    return 0;
+  }
+  return this->beginPacket(ip, port);
+}
+
+int EthernetUDP::endPacket() {
+  if (this->sock >= MAX_SOCK_NUM || sockets[this->sock].kind != host_socket_udp) {
+    return 0;
+  }
+
+  struct sockaddr_in sa;
+  loopback_at(&sa, this->tx_ip, this->tx_port);
+  ssize_t n = sendto(sockets[this->sock].fd, this->tx, this->tx_len, 0, (struct sockaddr *)&sa, sizeof(sa));
+  this->tx_len = 0;
+  return n >= 0;
+}
+
+size_t EthernetUDP::write(uint8_t c) {
+  return this->write(&c, 1);
+}
+
+size_t EthernetUDP::write(const uint8_t *buffer, size_t size) {
+  if (size > sizeof(this->tx) - this->tx_len) {
+    size = sizeof(this->tx) - this->tx_len;
+  }
+
+  fr12_host_counters.eth_write_calls++;
+  fr12_host_counters.eth_write_bytes += size;
+  memcpy(this->tx + this->tx_len, buffer, size);
+  this->tx_len += size;
+  return size;
+}
+
+int EthernetUDP::parsePacket() {
+  if (this->sock >= MAX_SOCK_NUM || sockets[this->sock].kind != host_socket_udp) {
+    return 0;
+  }
+
+  // Give the built-in NTP server a chance to answer first
+  ntp_service();
+
+  struct sockaddr_in from;
+  socklen_t from_len = sizeof(from);
+  ssize_t n = recvfrom(sockets[this->sock].fd, this->rx, sizeof(this->rx), 0, (struct sockaddr *)&from, &from_len);
+
+  fr12_host_counters.eth_read_calls++;
+  if (n <= 0) {
+    this->rx_len = this->rx_index = 0;
+    return 0;
+  }
+
+  this->rx_len = n;
+  this->rx_index = 0;
+  this->remote_ip = IPAddress((const uint8_t *)&from.sin_addr.s_addr);
+  this->remote_port = ntohs(from.sin_port) - fr12_host_net_port(0);
+  return (int)n;
+}
+
+int EthernetUDP::available() {
+  return this->rx_len - this->rx_index;
+}
+
+int EthernetUDP::read() {
+  if (this->rx_index >= this->rx_len) {
+    return -1;
+  }
+  return this->rx[this->rx_index++];
+}
+
+int EthernetUDP::read(unsigned char *buffer, size_t len) {
+  size_t left = this->rx_len - this->rx_index;
+  if (left == 0) {
+    return -1;
+  }
+
+  if (len > left) {
+    len = left;
+  }
+  memcpy(buffer, this->rx + this->rx_index, len);
+  this->rx_index += len;
+  return (int)len;
+}
+
+int EthernetUDP::peek() {
+  if (this->rx_index >= this->rx_len) {
+    return -1;
+  }
+  return this->rx[this->rx_index];
+}
+
+void EthernetUDP::flush() {
+  this->rx_index = this->rx_len;
+}
+
+// DNSClient
+int DNSClient::inet_aton(const char *address, IPAddress &result) {
+  struct in_addr a;
+  if (::inet_aton(address, &a) == 0) {
+    return 0;
+  }
+
+  result = IPAddress((const uint8_t *)&a.s_addr);
+  return 1;
+}
+
+int DNSClient::getHostByName(const char *hostname, IPAddress &result) {
+  const char *env = getenv("FR12_HOST_DNS");
+
+  if (this->inet_aton(hostname, result)) {
+    return 1;
+  }
+
+  // The real client reports a timeout as -1
+  if (env != NULL && strcmp(env, "fail") == 0) {
+    return -1;
+  }
+
+  result = IPAddress(127, 0, 0, 1);
+  return 1;
+}
@@ -0,0 +1,95 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Controls and counters for the simulated HAL. Only the host harness uses
+// these; firmware sources never include this file.
+
+#ifndef FR12_HOST_H
+#define FR12_HOST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Clock modes
+enum {
+  // millis() follows CLOCK_MONOTONIC; delay() sleeps
+  fr12_host_clock_real = 0,
+
+  // millis() only moves when advanced; delay() returns immediately
+  fr12_host_clock_virtual = 1
+};
+
+// EEPROM geometry and timing
+enum {
+  fr12_host_eeprom_size = 4096,
+  fr12_host_eeprom_write_us = 3400
+};
+
+struct fr12_host_stats {
+  // EEPROM
+  uint32_t eeprom_reads;
+  uint32_t eeprom_writes;
+  uint32_t eeprom_max_cell_writes;
+
+  // Ethernet (each call is at least one SPI transaction on the W5100;
+  // reads count read() and available() alike)
+  uint32_t eth_write_calls;
+  uint32_t eth_write_bytes;
+  uint32_t eth_read_calls;
+  uint32_t eth_accepts;
+
+  // Displays
+  uint32_t glcd_pixel_writes;
+  uint32_t lcd_writes;
+};
+
+// Clock (simulated time, in microseconds)
+void fr12_host_clock_mode(uint8_t mode);
+void fr12_host_clock_set(uint64_t us);
+void fr12_host_clock_advance(uint64_t us);
+void fr12_host_clock_poll_step(uint32_t us);
+uint64_t fr12_host_clock_us();
+uint64_t fr12_host_wall_us();
+
+// EEPROM image
+int fr12_host_eeprom_open(const char *path);
+void fr12_host_eeprom_close();
+
+// Writes to cells [offset, offset + len) since the counters were cleared
+uint32_t fr12_host_eeprom_wear(size_t offset, size_t len);
+
+// Pins
+void fr12_host_pin_input(uint8_t pin, uint8_t value);
+uint8_t fr12_host_pin_output(uint8_t pin);
+
+// Networking
+void fr12_host_net_port_offset(uint16_t offset);
+uint16_t fr12_host_net_port(uint16_t port);
+int fr12_host_ntp_responder(int enable);
+void fr12_host_net_close_all();
+
+// Displays
+void fr12_host_glcd_dump(FILE *f);
+void fr12_host_lcd_dump(FILE *f);
+
+// Reset (jumps back to the harness, which runs setup() again)
+void fr12_host_reset_hook(void (*hook)());
+void fr12_host_reset();
+
+// Counters
+void fr12_host_stats_get(fr12_host_stats *stats);
+void fr12_host_stats_clear();
+
+// Internal counters shared between the HAL units
+extern fr12_host_stats fr12_host_counters;
+uint64_t fr12_host_clock_poll();
+void fr12_host_interrupts();
+void fr12_host_eeprom_interrupt();
+void fr12_host_timer1_interrupt();
+void fr12_host_eeprom_clear_wear();
+
+#endif /* FR12_HOST_H */
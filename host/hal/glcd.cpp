@@ -0,0 +1,283 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "glcd.h"
+#include "fr12_host.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// glcd v3 font header layout
+enum {
+  font_length = 0,
+  font_fixed_width = 2,
+  font_height = 3,
+  font_first_char = 4,
+  font_char_count = 5,
+  font_width_table = 6
+};
+
+uint8_t glcd_Device::ram[DISPLAY_HEIGHT / 8][DISPLAY_WIDTH];
+uint8_t glcd_Device::inverted = 0;
+
+glcd GLCD;
+
+static uint8_t font_is_fixed(Font_t font) {
+  return pgm_read_byte(font + font_length) == 0 && pgm_read_byte(font + font_length + 1) == 0;
+}
+
+// glcd_Device
+void glcd_Device::SetDot(uint8_t x, uint8_t y, uint8_t color) {
+  if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) {
+    return;
+  }
+
+  if (inverted) {
+    color = ~color;
+  }
+
+  fr12_host_counters.glcd_pixel_writes++;
+  if (color == BLACK) {
+    ram[y / 8][x] |= _BV(y % 8);
+  } else {
+    ram[y / 8][x] &= ~_BV(y % 8);
+  }
+}
+
+uint8_t glcd_Device::GetDot(uint8_t x, uint8_t y) {
+  if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) {
+    return WHITE;
+  }
+
+  uint8_t set = (ram[y / 8][x] & _BV(y % 8)) != 0;
+  if (inverted) {
+    set = !set;
+  }
+  return set ? BLACK : WHITE;
+}
+
+void glcd_Device::FillRect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t color) {
+  for (uint16_t y = y1; y <= y2; y++) {
+    for (uint16_t x = x1; x <= x2; x++) {
+      SetDot(x, y, color);
+    }
+  }
+}
+
+// gText
+gText::gText() : font(NULL), x1(0), y1(0), x2(DISPLAY_WIDTH - 1), y2(DISPLAY_HEIGHT - 1), x(0), y(0) {
+}
+
+gText::gText(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) : font(NULL), x1(x1), y1(y1), x2(x2), y2(y2), x(x1), y(y1) {
+}
+
+gText::gText(uint8_t x1, uint8_t y1, uint8_t columns, uint8_t rows, Font_t font) {
+  this->DefineArea(x1, y1, columns, rows, font);
+}
+
+void gText::DefineArea(uint8_t x1, uint8_t y1, uint8_t columns, uint8_t rows, Font_t font) {
+  uint16_t x2 = x1 + columns * (pgm_read_byte(font + font_fixed_width) + 1) - 1;
+  uint16_t y2 = y1 + rows * (pgm_read_byte(font + font_height) + 1) - 1;
+
+  this->x1 = x1;
+  this->y1 = y1;
+  this->x2 = x2 < DISPLAY_WIDTH ? x2 : DISPLAY_WIDTH - 1;
+  this->y2 = y2 < DISPLAY_HEIGHT ? y2 : DISPLAY_HEIGHT - 1;
+  this->font = font;
+  this->x = x1;
+  this->y = y1;
+}
+
+void gText::ClearArea() {
+  FillRect(this->x1, this->y1, this->x2, this->y2, WHITE);
+  this->x = this->x1;
+  this->y = this->y1;
+}
+
+void gText::SelectFont(Font_t font) {
+  this->font = font;
+}
+
+void gText::CursorTo(uint8_t column, uint8_t row) {
+  if (this->font == NULL) {
+    return;
+  }
+
+  this->x = this->x1 + column * (pgm_read_byte(this->font + font_fixed_width) + 1);
+  this->y = this->y1 + row * (pgm_read_byte(this->font + font_height) + 1);
+}
+
+void gText::CursorToXY(uint8_t x, uint8_t y) {
+  this->x = this->x1 + x;
+  this->y = this->y1 + y;
+}
+
+uint8_t gText::CharWidth(uint8_t c) {
+  if (this->font == NULL) {
+    return 0;
+  }
+
+  uint8_t first = pgm_read_byte(this->font + font_first_char);
+  uint8_t count = pgm_read_byte(this->font + font_char_count);
+  if (c < first || c >= first + count) {
+    return 0;
+  }
+
+  if (font_is_fixed(this->font)) {
+    return pgm_read_byte(this->font + font_fixed_width);
+  }
+  return pgm_read_byte(this->font + font_width_table + c - first);
+}
+
+uint16_t gText::StringWidth(const char *str) {
+  uint16_t w = 0;
+  while (*str != '\0') {
+    w += this->CharWidth(*str++) + 1;
+  }
+  return w;
+}
+
+uint16_t gText::StringWidth_P(PGM_P str) {
+  return this->StringWidth(str);
+}
+
+void gText::ScrollUp(uint8_t pixels) {
+  for (uint16_t y = this->y1; y <= this->y2; y++) {
+    for (uint16_t x = this->x1; x <= this->x2; x++) {
+      uint16_t from = y + pixels;
+      SetDot(x, y, from <= this->y2 ? GetDot(x, from) : WHITE);
+    }
+  }
+}
+
+int gText::PutChar(uint8_t c) {
+  if (this->font == NULL) {
+    return 0;
+  }
+
+  uint8_t height = pgm_read_byte(this->font + font_height);
+
+  // New line, scrolling the area if we run off the bottom
+  if (c == '\n') {
+    this->x = this->x1;
+    if (this->y + 2 * (height + 1) - 1 > this->y2) {
+      this->ScrollUp(height + 1);
+    } else {
+      this->y += height + 1;
+    }
+    return 1;
+  }
+
+  uint8_t width = this->CharWidth(c);
+  if (width == 0) {
+    return 1;
+  }
+
+  // Wrap when the character would not fit
+  if (this->x + width > this->x2 + 1) {
+    this->PutChar('\n');
+  }
+
+  // Find the glyph: sum of the widths before it, one byte per column per page
+  uint8_t first = pgm_read_byte(this->font + font_first_char);
+  uint8_t count = pgm_read_byte(this->font + font_char_count);
+  uint8_t pages = (height + 7) / 8;
+  const uint8_t *data;
+
+  if (font_is_fixed(this->font)) {
+    data = this->font + font_width_table + (uint16_t)(c - first) * width * pages;
+  } else {
+    uint16_t offset = 0;
+    for (uint8_t i = 0; i < c - first; i++) {
+      offset += pgm_read_byte(this->font + font_width_table + i);
+    }
+    data = this->font + font_width_table + count + offset * pages;
+  }
+
+  // Draw column by column, followed by one blank column of spacing
+  for (uint8_t col = 0; col <= width; col++) {
+    uint16_t px = this->x + col;
+    if (px > this->x2) {
+      break;
+    }
+
+    for (uint8_t row = 0; row < height; row++) {
+      uint16_t py = this->y + row;
+      if (py > this->y2) {
+        break;
+      }
+
+      uint8_t bits = col < width ? pgm_read_byte(data + (row / 8) * width + col) : 0;
+      SetDot(px, py, (bits & _BV(row % 8)) ? BLACK : WHITE);
+    }
+  }
+
+  this->x += width + 1;
+  return 1;
+}
+
+void gText::Puts(const char *str) {
+  while (*str != '\0') {
+    this->PutChar(*str++);
+  }
+}
+
+void gText::Puts_P(PGM_P str) {
+  uint8_t c;
+  while ((c = pgm_read_byte(str++)) != '\0') {
+    this->PutChar(c);
+  }
+}
+
+void gText::Printf(const char *format, ...) {
+  char buf[128];
+  va_list ap;
+  va_start(ap, format);
+  vsnprintf(buf, sizeof(buf), format, ap);
+  va_end(ap);
+  this->Puts(buf);
+}
+
+void gText::Printf_P(PGM_P format, ...) {
+  char buf[128];
+  va_list ap;
+  va_start(ap, format);
+  vsnprintf_P(buf, sizeof(buf), format, ap);
+  va_end(ap);
+  this->Puts(buf);
+}
+
+size_t gText::write(uint8_t c) {
+  return this->PutChar(c);
+}
+
+// glcd
+glcd::glcd() : gText() {
+}
+
+void glcd::Init(uint8_t invert) {
+  inverted = invert;
+  this->x1 = this->y1 = 0;
+  this->x2 = DISPLAY_WIDTH - 1;
+  this->y2 = DISPLAY_HEIGHT - 1;
+  this->ClearScreen();
+}
+
+void glcd::ClearScreen(uint8_t color) {
+  FillRect(0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1, color);
+  this->x = this->y = 0;
+}
+
+void fr12_host_glcd_dump(FILE *f) {
+  for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+    char line[DISPLAY_WIDTH + 1];
+    for (uint8_t x = 0; x < DISPLAY_WIDTH; x++) {
+      line[x] = glcd_Device::GetDot(x, y) == BLACK ? '#' : '.';
+    }
+    line[DISPLAY_WIDTH] = '\0';
+    fprintf(f, "%s\n", line);
+  }
+}
@@ -0,0 +1,85 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the glcd v3 library on a 128x64 KS0108 panel. Text
+// areas render the real fonts into an in-memory page-ordered framebuffer
+// laid out like the controller's RAM; fr12_host_glcd_dump() prints it.
+
+#ifndef FR12_HOST_GLCD_H
+#define FR12_HOST_GLCD_H
+
+#include "Arduino.h"
+#include "glcd_Config.h"
+
+typedef const uint8_t *Font_t;
+
+#define NON_INVERTED false
+#define INVERTED true
+
+#define BLACK 0xFF
+#define WHITE 0x00
+
+// Framebuffer shared by every area
+class glcd_Device : public Print {
+public:
+  static uint8_t ram[DISPLAY_HEIGHT / 8][DISPLAY_WIDTH];
+  static uint8_t inverted;
+
+  static void SetDot(uint8_t x, uint8_t y, uint8_t color);
+  static uint8_t GetDot(uint8_t x, uint8_t y);
+  static void FillRect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t color);
+};
+
+class gText : public glcd_Device {
+public:
+  gText();
+  gText(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+  gText(uint8_t x1, uint8_t y1, uint8_t columns, uint8_t rows, Font_t font);
+
+  void DefineArea(uint8_t x1, uint8_t y1, uint8_t columns, uint8_t rows, Font_t font);
+  void ClearArea();
+  void SelectFont(Font_t font);
+  void CursorTo(uint8_t column, uint8_t row);
+  void CursorToXY(uint8_t x, uint8_t y);
+  int PutChar(uint8_t c);
+  void Puts(const char *str);
+  void Puts_P(PGM_P str);
+  void Printf(const char *format, ...);
+  void Printf_P(PGM_P format, ...);
+  uint8_t CharWidth(uint8_t c);
+  uint16_t StringWidth(const char *str);
+  uint16_t StringWidth_P(PGM_P str);
+  virtual size_t write(uint8_t c);
+
+  using Print::write;
+protected:
+  void ScrollUp(uint8_t pixels);
+
+  Font_t font;
+  uint8_t x1, y1, x2, y2;
+  uint8_t x, y;
+};
+
+class glcd : public gText {
+public:
+  glcd();
+
+  void Init(uint8_t invert = NON_INVERTED);
+  void ClearScreen(uint8_t color = WHITE);
+
+  static const uint8_t Left = 0;
+  static const uint8_t Right = DISPLAY_WIDTH - 1;
+  static const uint8_t Top = 0;
+  static const uint8_t Bottom = DISPLAY_HEIGHT - 1;
+  static const uint8_t CenterX = DISPLAY_WIDTH / 2;
+  static const uint8_t CenterY = DISPLAY_HEIGHT / 2;
+  static const uint8_t Width = DISPLAY_WIDTH;
+  static const uint8_t Height = DISPLAY_HEIGHT;
+};
+
+extern glcd GLCD;
+
+#endif /* FR12_HOST_GLCD_H */
@@ -0,0 +1,15 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for glcd_Buildinfo.h.
+
+#ifndef FR12_HOST_GLCD_BUILDINFO_H
+#define FR12_HOST_GLCD_BUILDINFO_H
+
+#define GLCD_GLCDLIB_DATESTR "host"
+#define GLCD_GLCDLIB_BUILDSTR "host"
+
+#endif /* FR12_HOST_GLCD_BUILDINFO_H */
@@ -0,0 +1,15 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for glcd_Config.h: a single 128x64 KS0108 panel.
+
+#ifndef FR12_HOST_GLCD_CONFIG_H
+#define FR12_HOST_GLCD_CONFIG_H
+
+#define DISPLAY_WIDTH 128
+#define DISPLAY_HEIGHT 64
+
+#endif /* FR12_HOST_GLCD_CONFIG_H */
@@ -0,0 +1,78 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "LiquidCrystal.h"
+#include "fr12_host.h"
+
+// The most recently started display, for dumping
+static LiquidCrystal *active = NULL;
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) {
+  this->begin(16, 1);
+}
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) {
+  this->begin(16, 1);
+}
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+  this->begin(16, 1);
+}
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+  this->begin(16, 1);
+}
+
+LiquidCrystal::~LiquidCrystal() {
+  if (active == this) {
+    active = NULL;
+  }
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows) {
+  this->cols = cols < fr12_host_lcd_max_cols ? cols : fr12_host_lcd_max_cols;
+  this->rows = rows < fr12_host_lcd_max_rows ? rows : fr12_host_lcd_max_rows;
+  this->clear();
+  active = this;
+}
+
+void LiquidCrystal::clear() {
+  for (uint8_t r = 0; r < fr12_host_lcd_max_rows; r++) {
+    memset(this->text[r], ' ', this->cols);
+    this->text[r][this->cols] = '\0';
+  }
+  this->home();
+}
+
+void LiquidCrystal::home() {
+  this->col = this->row = 0;
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row) {
+  this->col = col;
+  this->row = row;
+}
+
+size_t LiquidCrystal::write(uint8_t c) {
+  fr12_host_counters.lcd_writes++;
+
+  // Characters past the visible area go to DDRAM nobody looks at
+  if (this->row < this->rows && this->col < this->cols) {
+    this->text[this->row][this->col] = (c >= 0x20 && c < 0x7f) ? c : '?';
+  }
+  this->col++;
+  return 1;
+}
+
+void fr12_host_lcd_dump(FILE *f) {
+  if (active == NULL) {
+    return;
+  }
+
+  for (uint8_t r = 0; r < active->rows; r++) {
+    fprintf(f, "|%s|\n", active->text[r]);
+  }
+}
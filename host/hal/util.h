@@ -0,0 +1,13 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the Ethernet library's util.h. Its byte order macros
+// would clash with the host's, and fr12 does not use them.
+
+#ifndef FR12_HOST_UTIL_H
+#define FR12_HOST_UTIL_H
+
+#endif /* FR12_HOST_UTIL_H */
@@ -0,0 +1,33 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for avr-libc's <util/crc16.h>, with the same polynomials
+// as the optimized AVR versions.
+
+#ifndef FR12_HOST_UTIL_CRC16_H
+#define FR12_HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+// CRC-16, polynomial 0xa001 (x^16 + x^15 + x^2 + 1), reflected
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+  crc ^= a;
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : (crc >> 1);
+  }
+  return crc;
+}
+
+// Dallas/Maxim 1-Wire CRC-8, polynomial 0x8c (x^8 + x^5 + x^4 + 1), reflected
+static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data) {
+  crc ^= data;
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 1) ? (crc >> 1) ^ 0x8c : (crc >> 1);
+  }
+  return crc;
+}
+
+#endif /* FR12_HOST_UTIL_CRC16_H */
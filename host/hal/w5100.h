@@ -0,0 +1,24 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host stand-in for the W5100 driver constants. The chip has four sockets;
+// the simulation enforces the same limit across TCP and UDP.
+
+#ifndef FR12_HOST_W5100_H
+#define FR12_HOST_W5100_H
+
+#define MAX_SOCK_NUM 4
+
+class SnSR {
+public:
+  static const uint8_t CLOSED = 0x00;
+  static const uint8_t LISTEN = 0x14;
+  static const uint8_t ESTABLISHED = 0x17;
+  static const uint8_t CLOSE_WAIT = 0x1C;
+  static const uint8_t UDP = 0x22;
+};
+
+#endif /* FR12_HOST_W5100_H */
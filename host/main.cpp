@@ -0,0 +1,498 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Host benchmark harness. Boots the real sketch against the simulated HAL,
+// times loop() and in-process HTTP round trips, and reports the HAL's
+// EEPROM, Ethernet and display counters. Exits non-zero if any request
+// fails or answers with an unexpected status.
+
+#include "Arduino.h"
+#include "fr12_host.h"
+
+#include "net.h"
+#include "config.h"
+
+#include <errno.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Sketch entry points (fr12.ino)
+void setup();
+void loop();
+
+enum {
+  bench_max_paths = 32,
+  bench_max_sections = 4,
+  bench_max_stalled = 4,
+  bench_response_max = 2048,
+  bench_request_max_loops = 100000
+};
+
+struct bench_path {
+  const char *path;
+  uint16_t expect;
+  const char *body;
+
+  // A number in the response that has to fall in [min, max]
+  char key[24];
+  long min, max;
+};
+
+// A config section, and how many bytes of it a run may write
+struct bench_section {
+  const char *name;
+  size_t offset, size;
+  uint32_t max;
+};
+
+static const bench_section bench_sections[] = {
+  { "countdown", offsetof(fr12_eeprom, union_station), sizeof(fr12_union_station_serialized), 0 },
+  { "lcd", offsetof(fr12_eeprom, lcd), sizeof(fr12_lcd_serialized), 0 },
+  { "net", offsetof(fr12_eeprom, net), sizeof(fr12_net_serialized), 0 },
+  { "ntp", offsetof(fr12_eeprom, ntp), sizeof(fr12_ntp_serialized), 0 },
+  { "time", offsetof(fr12_eeprom, time), sizeof(fr12_time_serialized), 0 },
+  { "lease", offsetof(fr12_eeprom, lease), sizeof(fr12_net_lease_serialized), 0 },
+  { "events", offsetof(fr12_eeprom, events), sizeof(fr12_events_serialized), 0 }
+};
+
+struct bench_options {
+  const char *eeprom;
+  uint8_t clock_mode;
+  uint32_t loop_step_us;
+  uint32_t loops;
+  uint32_t requests;
+  uint8_t stalled;
+  bench_path paths[bench_max_paths];
+  uint8_t path_count;
+  bench_section sections[bench_max_sections];
+  uint8_t section_count;
+  uint8_t ntp;
+  uint8_t hold_reset;
+  uint8_t dump;
+};
+
+struct bench_results {
+  uint64_t boot_wall_us, boot_sim_us;
+  uint64_t loop_wall_us;
+  uint64_t http_total_us, http_min_us, http_max_us;
+  uint64_t http_loops;
+  uint32_t http_done, http_failed;
+  uint32_t stalled_timed_out;
+  uint32_t resets;
+  uint32_t sections_failed;
+};
+
+static bench_options opt;
+static bench_results res;
+static jmp_buf reset_point;
+
+// Request in flight, kept outside the stack so it survives a /reset
+static int http_fd = -1;
+static char http_response[bench_response_max];
+static size_t http_response_len;
+static uint32_t http_index;
+
+// Clients that send half a request line and then go quiet
+static int stalled_fd[bench_max_stalled];
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+    "usage: %s [options]\n"
+    "  -e FILE   EEPROM image (default fr12.eeprom)\n"
+    "  -R        follow the real clock (default: virtual clock)\n"
+    "  -k US     advance the virtual clock by US after each loop() (default 1000)\n"
+    "  -n N      loop() iterations to time (default 10000)\n"
+    "  -r N      HTTP requests to issue (default 0)\n"
+    "  -p [CODE:]PATH\n"
+    "            request path, repeat to cycle; expected status defaults to 200\n"
+    "  -b TEXT   the last -p's response must contain TEXT\n"
+    "  -j KEY:MIN:MAX\n"
+    "            the last -p's response must have a number KEY in MIN..MAX\n"
+    "  -w SECTION:MAX\n"
+    "            write at most MAX bytes of a config section (countdown, lcd,\n"
+    "            net, ntp, time, lease or events) after boot\n"
+    "  -s N      hold N clients open with a partial request (max 4)\n"
+    "  -N        answer NTP queries from the host clock (FR12_HOST_NTP_PPM skews it,\n"
+    "            FR12_HOST_NTP_SERVERS sets how far off each of 127.0.0.1-4 is)\n"
+    "  -H        hold the reset pin high during boot\n"
+    "  -d        dump both displays at exit\n", argv0);
+}
+
+static void on_reset() {
+  res.resets++;
+  longjmp(reset_point, 1);
+}
+
+static void step() {
+  loop();
+  if (opt.clock_mode == fr12_host_clock_virtual) {
+    fr12_host_clock_advance(opt.loop_step_us);
+  }
+}
+
+static int http_open() {
+  struct sockaddr_in sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa.sin_port = htons(fr12_host_net_port(fr12_net_http_port));
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    perror("fr12-host: connect");
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  return fd;
+}
+
+static int http_connect(const bench_path *p) {
+  char request[256];
+  int fd = http_open();
+  if (fd < 0) {
+    return -1;
+  }
+
+  int len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: fr12\r\nUser-Agent: fr12-host\r\n\r\n", p->path);
+  if (send(fd, request, len, 0) != len) {
+    perror("fr12-host: send");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Returns 1 once the server has closed the connection
+static int http_poll(int fd, char *response, size_t *len, size_t max) {
+  for (;;) {
+    size_t room = max - 1 - *len;
+    char scratch[256];
+    char *dst = room > 0 ? response + *len : scratch;
+    ssize_t n = recv(fd, dst, room > 0 ? room : sizeof(scratch), MSG_DONTWAIT);
+
+    if (n == 0) {
+      return 1;
+    }
+    if (n < 0) {
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : 1;
+    }
+    if (room > 0) {
+      *len += n;
+    }
+  }
+}
+
+static void stalled_open() {
+  for (uint8_t i = 0; i < opt.stalled; i++) {
+    stalled_fd[i] = http_open();
+    if (stalled_fd[i] >= 0) {
+      send(stalled_fd[i], "GET /get/time HT", 16, 0);
+    }
+  }
+}
+
+// Runs the loop until every stalled client has been dropped
+static void stalled_finish() {
+  for (uint8_t i = 0; i < opt.stalled; i++) {
+    char response[64];
+    size_t len = 0;
+    unsigned status = 0;
+    uint32_t loops = 0;
+
+    if (stalled_fd[i] < 0) {
+      continue;
+    }
+
+    while (!http_poll(stalled_fd[i], response, &len, sizeof(response)) && loops < bench_request_max_loops) {
+      step();
+      loops++;
+    }
+
+    response[len] = '\0';
+    sscanf(response, "HTTP/1.1 %u", &status);
+    if (status == 408) {
+      res.stalled_timed_out++;
+    } else {
+      fprintf(stderr, "fr12-host: stalled client %u: expected 408, got %u\n", i, status);
+      res.http_failed++;
+    }
+
+    close(stalled_fd[i]);
+    stalled_fd[i] = -1;
+  }
+}
+
+static void http_finish(const bench_path *p, uint64_t us, uint32_t loops) {
+  unsigned status = 0;
+
+  http_response[http_response_len] = '\0';
+  sscanf(http_response, "HTTP/1.1 %u", &status);
+
+  if (status != p->expect) {
+    fprintf(stderr, "fr12-host: %s: expected %u, got %u\n", p->path, p->expect, status);
+    res.http_failed++;
+  }
+  else if (p->body != NULL && strstr(http_response, p->body) == NULL) {
+    const char *body = strstr(http_response, "\r\n\r\n");
+    fprintf(stderr, "fr12-host: %s: expected %s in %s", p->path, p->body, body != NULL ? body + 4 : http_response);
+    res.http_failed++;
+  }
+  else if (p->key[0] != '\0') {
+    char field[sizeof(p->key) + 4];
+    snprintf(field, sizeof(field), "\"%s\":", p->key);
+    const char *value = strstr(http_response, field);
+    long n = value != NULL ? strtol(value + strlen(field), NULL, 10) : 0;
+    if (value == NULL) {
+      fprintf(stderr, "fr12-host: %s: expected %s in %ld..%ld, got nothing\n", p->path, p->key, p->min, p->max);
+      res.http_failed++;
+    }
+    else if (n < p->min || n > p->max) {
+      fprintf(stderr, "fr12-host: %s: expected %s in %ld..%ld, got %ld\n", p->path, p->key, p->min, p->max, n);
+      res.http_failed++;
+    }
+  }
+
+  res.http_done++;
+  res.http_total_us += us;
+  res.http_loops += loops;
+  if (res.http_min_us == 0 || us < res.http_min_us) {
+    res.http_min_us = us;
+  }
+  if (us > res.http_max_us) {
+    res.http_max_us = us;
+  }
+}
+
+static void run_requests() {
+  for (; http_index < opt.requests; http_index++) {
+    const bench_path *p = &opt.paths[http_index % opt.path_count];
+    uint64_t start = fr12_host_wall_us();
+    uint32_t loops = 0;
+
+    if (http_fd < 0) {
+      http_response_len = 0;
+      http_fd = http_connect(p);
+      if (http_fd < 0) {
+        res.http_failed++;
+        continue;
+      }
+    }
+
+    while (!http_poll(http_fd, http_response, &http_response_len, sizeof(http_response)) && loops < bench_request_max_loops) {
+      step();
+      loops++;
+    }
+
+    if (loops >= bench_request_max_loops) {
+      fprintf(stderr, "fr12-host: %s: no response after %u loops\n", p->path, loops);
+      res.http_failed++;
+    } else {
+      http_finish(p, fr12_host_wall_us() - start, loops);
+    }
+
+    close(http_fd);
+    http_fd = -1;
+  }
+}
+
+// Lets the firmware's EEPROM write-back queue drain before exiting, as it
+// would on a unit that stays powered
+static void eeprom_settle() {
+  for (uint32_t loops = 0; (EECR & _BV(EERIE)) && loops < bench_request_max_loops; loops++) {
+    step();
+  }
+}
+
+// Sections a run wasn't meant to rewrite
+static void check_sections() {
+  for (uint8_t a = 0; a < opt.section_count; a++) {
+    const bench_section *section = &opt.sections[a];
+    uint32_t writes = fr12_host_eeprom_wear(section->offset, section->size);
+    if (writes > section->max) {
+      fprintf(stderr, "fr12-host: %s: expected at most %u bytes written, got %u\n", section->name, section->max, writes);
+      res.sections_failed++;
+    }
+  }
+}
+
+static void report() {
+  fr12_host_stats s;
+  fr12_host_stats_get(&s);
+
+  printf("boot:     %.1f ms wall, %.1f s simulated\n", res.boot_wall_us / 1000.0, res.boot_sim_us / 1e6);
+  if (opt.loops > 0) {
+    printf("loop:     %u iterations, %.2f us/iter, %.0f iter/s\n", opt.loops,
+      (double)res.loop_wall_us / opt.loops, res.loop_wall_us ? opt.loops * 1e6 / res.loop_wall_us : 0.0);
+  }
+  if (opt.requests > 0) {
+    printf("http:     %u requests, %u failed, latency avg %.1f / min %llu / max %llu us, %.1f loops/request\n",
+      res.http_done, res.http_failed, res.http_done ? (double)res.http_total_us / res.http_done : 0.0,
+      (unsigned long long)res.http_min_us, (unsigned long long)res.http_max_us,
+      res.http_done ? (double)res.http_loops / res.http_done : 0.0);
+  }
+  printf("eeprom:   %u reads, %u writes, max %u writes per cell\n", s.eeprom_reads, s.eeprom_writes, s.eeprom_max_cell_writes);
+  printf("ethernet: %u write calls, %u bytes, %u read calls, %u accepts\n", s.eth_write_calls, s.eth_write_bytes, s.eth_read_calls, s.eth_accepts);
+  printf("display:  %u glcd pixel writes, %u lcd writes\n", s.glcd_pixel_writes, s.lcd_writes);
+  if (opt.stalled > 0) {
+    printf("stalled:  %u clients, %u timed out with 408\n", opt.stalled, res.stalled_timed_out);
+  }
+  if (res.resets > 0) {
+    printf("resets:   %u\n", res.resets);
+  }
+
+  if (opt.dump) {
+    fr12_host_glcd_dump(stdout);
+    fr12_host_lcd_dump(stdout);
+  }
+}
+
+int main(int argc, char **argv) {
+  int c;
+
+  opt.eeprom = "fr12.eeprom";
+  opt.clock_mode = fr12_host_clock_virtual;
+  opt.loop_step_us = 1000;
+  opt.loops = 10000;
+
+  while ((c = getopt(argc, argv, "e:Rk:n:r:p:b:j:w:s:NHdh")) != -1) {
+    switch (c) {
+    case 'e':
+      opt.eeprom = optarg;
+      break;
+    case 'R':
+      opt.clock_mode = fr12_host_clock_real;
+      break;
+    case 'k':
+      opt.loop_step_us = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      opt.loops = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      opt.requests = strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      if (opt.path_count < bench_max_paths) {
+        bench_path *p = &opt.paths[opt.path_count++];
+        const char *colon = strchr(optarg, ':');
+        p->expect = 200;
+        p->path = optarg;
+        p->body = NULL;
+        p->key[0] = '\0';
+        if (optarg[0] != '/' && colon != NULL) {
+          p->expect = atoi(optarg);
+          p->path = colon + 1;
+        }
+      }
+      break;
+    case 'b':
+      if (opt.path_count > 0) {
+        opt.paths[opt.path_count - 1].body = optarg;
+      }
+      break;
+    case 'j':
+      if (opt.path_count > 0) {
+        bench_path *p = &opt.paths[opt.path_count - 1];
+        if (sscanf(optarg, "%23[^:]:%ld:%ld", p->key, &p->min, &p->max) != 3) {
+          usage(argv[0]);
+          return 2;
+        }
+      }
+      break;
+    case 'w':
+      if (opt.section_count < bench_max_sections) {
+        const char *colon = strchr(optarg, ':');
+        uint8_t a = 0;
+        for (; a < sizeof(bench_sections) / sizeof(bench_sections[0]); a++) {
+          if (colon != NULL && strncmp(optarg, bench_sections[a].name, colon - optarg) == 0 && bench_sections[a].name[colon - optarg] == '\0') {
+            break;
+          }
+        }
+        if (a == sizeof(bench_sections) / sizeof(bench_sections[0])) {
+          usage(argv[0]);
+          return 2;
+        }
+        opt.sections[opt.section_count] = bench_sections[a];
+        opt.sections[opt.section_count++].max = strtoul(colon + 1, NULL, 0);
+      }
+      break;
+    case 's':
+      opt.stalled = strtoul(optarg, NULL, 0);
+      if (opt.stalled > bench_max_stalled) {
+        opt.stalled = bench_max_stalled;
+      }
+      break;
+    case 'N':
+      opt.ntp = 1;
+      break;
+    case 'H':
+      opt.hold_reset = 1;
+      break;
+    case 'd':
+      opt.dump = 1;
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (opt.path_count == 0) {
+    opt.paths[0].path = "/get/time";
+    opt.paths[0].expect = 200;
+    opt.path_count = 1;
+  }
+
+  fr12_host_clock_mode(opt.clock_mode);
+  if (fr12_host_eeprom_open(opt.eeprom) < 0) {
+    return 2;
+  }
+  if (opt.ntp && fr12_host_ntp_responder(1) < 0) {
+    return 2;
+  }
+  fr12_host_reset_hook(&on_reset);
+
+  // A /reset lands back here, just like the AVR's jump to the reset vector
+  if (setjmp(reset_point) == 0) {
+    fr12_host_pin_input(12, opt.hold_reset);
+
+    uint64_t wall = fr12_host_wall_us(), sim = fr12_host_clock_us();
+    setup();
+    res.boot_wall_us = fr12_host_wall_us() - wall;
+    res.boot_sim_us = fr12_host_clock_us() - sim;
+    fr12_host_pin_input(12, 0);
+
+    // Count only steady-state work from here on
+    fr12_host_stats_clear();
+    stalled_open();
+
+    uint64_t start = fr12_host_wall_us();
+    for (uint32_t i = 0; i < opt.loops; i++) {
+      step();
+    }
+    res.loop_wall_us = fr12_host_wall_us() - start;
+  } else {
+    setup();
+  }
+
+  run_requests();
+  stalled_finish();
+  eeprom_settle();
+  check_sections();
+  report();
+
+  fr12_host_net_close_all();
+  fr12_host_eeprom_close();
+  return res.http_failed > 0 || res.sections_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+// Writes an EEPROM image in an older release's layout, filled with known
+// values, so make check can boot the current firmware on it and see what
+// the upgrade kept. Layouts are spelled out byte by byte here rather than
+// taken from config.h, which only knows the newest one.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fr12_host.h"
+#include "util/crc16.h"
+
+enum {
+  seed_magic = 0x34544c40,
+  seed_sections_max = 8
+};
+
+// The time journal, which every layout keeps in the same place. Seeded
+// records are numbered from just under the wrap, so a long journal crosses
+// it.
+enum {
+  seed_journal_start = 0x200,
+  seed_journal_record = 7,
+  seed_journal_slots = (fr12_host_eeprom_size - seed_journal_start) / seed_journal_record,
+  seed_journal_sequence = 0xff00,
+  seed_journal_empty = 0xffff,
+  seed_journal_step = 60
+};
+
+// The values every layout gets, as far as it has room for them
+enum {
+  seed_countdown_to = 1900000000UL,
+  seed_seconds = 1500000000UL,
+  seed_sync_interval = 7200,
+  seed_drift = -1234
+};
+
+struct seed_image {
+  uint8_t data[fr12_host_eeprom_size];
+  uint16_t len;
+
+  // Where each section starts, and how many there are
+  uint16_t start[seed_sections_max];
+  uint8_t sections;
+};
+
+static void put(seed_image *im, const void *p, uint16_t len) {
+  memcpy(im->data + im->len, p, len);
+  im->len += len;
+}
+
+static void put8(seed_image *im, uint8_t v) {
+  put(im, &v, sizeof(v));
+}
+
+static void put16(seed_image *im, uint16_t v) {
+  put(im, &v, sizeof(v));
+}
+
+static void put32(seed_image *im, uint32_t v) {
+  put(im, &v, sizeof(v));
+}
+
+static void put_string(seed_image *im, const char *s, uint16_t size) {
+  uint8_t field[128];
+  memset(field, 0x00, sizeof(field));
+  strncpy((char *)field, s, size - 1);
+  put(im, field, size);
+}
+
+static void section(seed_image *im) {
+  im->start[im->sections++] = im->len;
+}
+
+// Writes count records, seed_journal_step seconds apart and ending
+// count steps after the seeded time. Only the first tear bytes of the last
+// one make it: the next byte is left erased, the way the AVR leaves a cell
+// it lost power writing, and the rest still hold whatever record was there.
+static void journal(seed_image *im, unsigned count, int tear) {
+  uint16_t sequence = seed_journal_sequence;
+
+  for (unsigned a = 1; a <= count; a++) {
+    uint8_t record[seed_journal_record], crc = 0;
+    uint32_t seconds = seed_seconds + a * seed_journal_step;
+    uint8_t *slot = im->data + seed_journal_start + ((a - 1) % seed_journal_slots) * seed_journal_record;
+
+    memcpy(record, &sequence, sizeof(sequence));
+    memcpy(record + sizeof(sequence), &seconds, sizeof(seconds));
+    for (uint8_t b = 0; b < seed_journal_record - 1; b++) {
+      crc = _crc_ibutton_update(crc, record[b]);
+    }
+    record[seed_journal_record - 1] = crc;
+
+    if (a == count && tear >= 0 && tear < seed_journal_record) {
+      memcpy(slot, record, tear);
+      slot[tear] = 0xff;
+    }
+    else {
+      memcpy(slot, record, sizeof(record));
+    }
+
+    // The firmware never uses the erased value either
+    if (++sequence == seed_journal_empty) {
+      sequence = 0;
+    }
+  }
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+    "usage: %s [options] VERSION FILE\n"
+    "  VERSION   134, 140, 141, 142, 143 or 144\n"
+    "  -c N      corrupt section N (0 union station, 1 lcd, 2 net, 3 ntp,\n"
+    "            4 time, 5 lease) after its CRC is worked out\n"
+    "  -j N      write N time journal records, a minute apart, after the seeded time\n"
+    "  -t N      tear the last journal record after N of its 7 bytes\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  static seed_image im;
+  int corrupt = -1, tear = -1, c;
+  unsigned records = 0;
+
+  while ((c = getopt(argc, argv, "c:j:t:h")) != -1) {
+    switch (c) {
+    case 'c':
+      corrupt = atoi(optarg);
+      break;
+    case 'j':
+      records = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      tear = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (argc - optind != 2) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  unsigned version = strtoul(argv[optind], NULL, 0);
+  if (version != 134 && (version < 140 || version > 144)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // Erased cells read back as 0xff, and the journal is blank unless asked
+  // for
+  memset(im.data, 0xff, sizeof(im.data));
+  journal(&im, records, tear);
+
+  // Header
+  put32(&im, seed_magic);
+  put16(&im, version);
+
+  // Union Station: the target, then (1.4.1) the boot flags, a slow boot
+  section(&im);
+  put32(&im, seed_countdown_to);
+  if (version >= 141) {
+    put8(&im, 0);
+  }
+
+  // LCD
+  section(&im);
+  put_string(&im, "seeded lcd", 32);
+  put8(&im, 1);
+  put8(&im, 2);
+  put8(&im, 3);
+
+  // Net: static, and a MAC other than the default
+  section(&im);
+  static const uint8_t mac[6] = { 0x72, 0x65, 0x64, 0x64, 0x69, 0x75 };
+  static const uint8_t ip[4] = { 10, 1, 2, 3 }, dns[4] = { 10, 1, 2, 4 }, gateway[4] = { 10, 1, 2, 1 }, subnet[4] = { 255, 255, 0, 0 };
+  put8(&im, 0x00);
+  put(&im, mac, sizeof(mac));
+  put(&im, ip, sizeof(ip));
+  put(&im, dns, sizeof(dns));
+  put(&im, gateway, sizeof(gateway));
+  put(&im, subnet, sizeof(subnet));
+
+  // NTP: one server, then (1.4.4) four
+  section(&im);
+  put_string(&im, "seed.example", 32);
+  if (version >= 144) {
+    put_string(&im, "seed1.example", 32);
+    put_string(&im, "", 32);
+    put_string(&im, "", 32);
+  }
+
+  // Time, then (1.4.3) the drift
+  section(&im);
+  put32(&im, seed_seconds);
+  put32(&im, seed_sync_interval);
+  if (version >= 143) {
+    put32(&im, (uint32_t)seed_drift);
+  }
+
+  // DHCP lease (1.4.2), long expired
+  if (version >= 142) {
+    static const uint8_t lease_ip[4] = { 10, 1, 9, 9 };
+    section(&im);
+    put(&im, lease_ip, sizeof(lease_ip));
+    put(&im, dns, sizeof(dns));
+    put(&im, gateway, sizeof(gateway));
+    put(&im, subnet, sizeof(subnet));
+    put32(&im, 1);
+  }
+
+  // CRCs (1.4.0)
+  if (version >= 140) {
+    uint16_t table = im.len;
+    for (uint8_t a = 0; a < im.sections; a++) {
+      uint16_t end = a + 1 < im.sections ? im.start[a + 1] : table, crc = 0xffff;
+      for (uint16_t b = im.start[a]; b < end; b++) {
+        crc = _crc16_update(crc, im.data[b]);
+      }
+      put16(&im, crc);
+    }
+  }
+
+  // Flip a bit the CRC (if there is one) doesn't know about
+  if (corrupt >= 0 && corrupt < im.sections) {
+    im.data[im.start[corrupt] + 1] ^= 0x01;
+  }
+
+  FILE *f = fopen(argv[optind + 1], "wb");
+  if (f == NULL || fwrite(im.data, sizeof(im.data), 1, f) != 1) {
+    perror("fr12-seed");
+    return 1;
+  }
+  fclose(f);
+  return 0;
+}
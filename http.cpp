@@ -0,0 +1,387 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "http.h"
+
+#include <EthernetClient.h>
+
+static const char fr12_http_get[] PROGMEM = "GET";
+static const char fr12_http_version[] PROGMEM = "HTTP/1.";
+static const char fr12_http_crlf[] PROGMEM = "\r\n";
+
+fr12_http_parser::fr12_http_parser() {
+  this->reset();
+}
+
+fr12_http_parser::~fr12_http_parser() {
+
+}
+
+void fr12_http_parser::reset() {
+  this->state = fr12_http_state_method;
+  this->index = 0;
+  this->error = 0;
+  this->query_offset = 0;
+  this->buffer[0] = '\0';
+  memset(&this->request, 0x00, sizeof(this->request));
+  this->request.method = fr12_http_method_get;
+}
+
+size_t fr12_http_parser::consume(const uint8_t *data, size_t len) {
+  size_t a;
+
+  for (a = 0; a < len && this->state < fr12_http_state_done; a++) {
+    register uint8_t c = data[a];
+
+    switch (this->state) {
+    case fr12_http_state_method:
+      // Method ends at the first space
+      if (c == ' ') {
+        if (this->index != sizeof(fr12_http_get) - 1) {
+          this->request.method = fr12_http_method_unknown;
+        }
+        this->state = fr12_http_state_target;
+        this->index = 0;
+      }
+      else if (c < 'A' || c > 'Z' || this->index >= fr12_http_max_method_len) {
+        this->fail(400);
+      }
+      else {
+        if (this->index >= sizeof(fr12_http_get) - 1 || c != pgm_read_byte(&fr12_http_get[this->index])) {
+          this->request.method = fr12_http_method_unknown;
+        }
+        this->index++;
+      }
+      break;
+
+    case fr12_http_state_target:
+      // Target ends at the next space. The first '?' splits off the query.
+      if (c == ' ') {
+        if (this->index == 0) {
+          this->fail(400);
+          break;
+        }
+
+        this->buffer[this->index] = '\0';
+        if (this->query_offset > 0) {
+          this->request.path_len = this->query_offset - 1;
+          this->request.query_len = this->index - this->query_offset;
+        }
+        else {
+          this->request.path_len = this->index;
+          this->query_offset = this->index;
+        }
+
+        this->state = fr12_http_state_version;
+        this->index = 0;
+      }
+      else if (c == '\r' || c == '\n') {
+        this->fail(400);
+      }
+      else if (this->index >= fr12_http_max_target_len) {
+        this->fail(414);
+      }
+      else if (c == '?' && this->query_offset == 0) {
+        this->buffer[this->index++] = '\0';
+        this->query_offset = this->index;
+      }
+      else {
+        this->buffer[this->index++] = c;
+      }
+      break;
+
+    case fr12_http_state_version:
+      // "HTTP/1." and then a single digit
+      if (this->index < sizeof(fr12_http_version) - 1) {
+        if (c != pgm_read_byte(&fr12_http_version[this->index])) {
+          this->fail(400);
+        }
+        this->index++;
+      }
+      else if (this->index == sizeof(fr12_http_version) - 1 && c >= '0' && c <= '9') {
+        this->index++;
+      }
+      else if (this->index == sizeof(fr12_http_version) && (c == '\r' || c == '\n')) {
+        this->state = c == '\r' ? fr12_http_state_line_end : fr12_http_state_header_start;
+      }
+      else {
+        this->fail(400);
+      }
+      break;
+
+    case fr12_http_state_line_end:
+      // CR must be followed by LF
+      if (c == '\n') {
+        this->state = fr12_http_state_header_start;
+      }
+      else {
+        this->fail(400);
+      }
+      break;
+
+    case fr12_http_state_header_start:
+      // A blank line ends the headers
+      if (c == '\r') {
+        this->state = fr12_http_state_headers_end;
+      }
+      else if (c == '\n') {
+        this->state = fr12_http_state_done;
+      }
+      else if (c == ':' || c == ' ' || c == '\t') {
+        this->fail(400);
+      }
+      else {
+        this->state = fr12_http_state_header_name;
+      }
+      break;
+
+    case fr12_http_state_header_name:
+      // Header names run up to the colon; values are skipped, not stored
+      if (c == ':') {
+        this->request.header_count++;
+        this->state = fr12_http_state_header_value;
+      }
+      else if (c == '\r' || c == '\n') {
+        this->fail(400);
+      }
+      break;
+
+    case fr12_http_state_header_value:
+      if (c == '\r') {
+        this->state = fr12_http_state_line_end;
+      }
+      else if (c == '\n') {
+        this->state = fr12_http_state_header_start;
+      }
+      break;
+
+    case fr12_http_state_headers_end:
+      if (c == '\n') {
+        this->state = fr12_http_state_done;
+      }
+      else {
+        this->fail(400);
+      }
+      break;
+    }
+  }
+
+  // Only GET is served
+  if (this->state == fr12_http_state_done && this->request.method != fr12_http_method_get) {
+    this->fail(405);
+  }
+
+  return a;
+}
+
+uint8_t fr12_http_parser::get_state() {
+  return this->state;
+}
+
+uint16_t fr12_http_parser::get_error() {
+  return this->error;
+}
+
+fr12_http_request *fr12_http_parser::get_request() {
+  this->request.path = this->buffer;
+  this->request.query = this->buffer + this->query_offset;
+  return &this->request;
+}
+
+void fr12_http_parser::fail(uint16_t code) {
+  this->state = fr12_http_state_error;
+  this->error = code;
+}
+
+uint8_t fr12_http_writer::buffer[fr12_http_writer_buffer_len];
+
+fr12_http_writer::fr12_http_writer(EthernetClient *client) {
+  this->client = client;
+  this->length = 0;
+}
+
+fr12_http_writer::~fr12_http_writer() {
+  this->flush();
+}
+
+size_t fr12_http_writer::write(uint8_t c) {
+  if (this->length >= sizeof(this->buffer)) {
+    this->flush();
+  }
+  this->buffer[this->length++] = c;
+  return 1;
+}
+
+size_t fr12_http_writer::write(const uint8_t *data, size_t len) {
+  size_t written = len;
+
+  while (len > 0) {
+    // Big blocks skip the staging buffer entirely
+    if (this->length == 0 && len >= sizeof(this->buffer)) {
+      this->client->write(data, len);
+      break;
+    }
+
+    size_t room = sizeof(this->buffer) - this->length;
+    if (room > len) {
+      room = len;
+    }
+
+    memcpy(this->buffer + this->length, data, room);
+    this->length += room;
+    data += room;
+    len -= room;
+
+    if (this->length >= sizeof(this->buffer)) {
+      this->flush();
+    }
+  }
+
+  return written;
+}
+
+size_t fr12_http_writer::print_P(PGM_P str) {
+  size_t written = 0;
+
+  for (;;) {
+    register uint8_t c = pgm_read_byte(str++);
+    if (c == '\0') {
+      break;
+    }
+
+    if (this->length >= sizeof(this->buffer)) {
+      this->flush();
+    }
+    this->buffer[this->length++] = c;
+    written++;
+  }
+
+  return written;
+}
+
+size_t fr12_http_writer::println_P(PGM_P str) {
+  size_t written = this->print_P(str);
+  return written + this->print_P(fr12_http_crlf);
+}
+
+void fr12_http_writer::flush() {
+  if (this->length > 0) {
+    this->client->write(this->buffer, this->length);
+    this->length = 0;
+  }
+}
+
+void fr12_http_writer::print_json(const fr12_http_json_object *object) {
+  for (uint8_t a = 0; a < object->field_count; a++) {
+    fr12_http_json_field field;
+
+    // Schemas live in flash
+    memcpy_P(&field, &object->fields[a], sizeof(field));
+
+    if (a > 0) {
+      this->write(',');
+    }
+    this->print_json_string(field.name, sizeof(field.name));
+    this->write(':');
+    this->print_json_field(&field, (const uint8_t *)object->data + field.offset);
+  }
+}
+
+void fr12_http_writer::print_json_field(const fr12_http_json_field *field, const uint8_t *data) {
+  switch (field->type) {
+  case fr12_http_json_uint:
+  case fr12_http_json_int:
+    {
+      // Little-endian, like everything on the AVR. Signed fields start from
+      // all ones when the top bit is set.
+      uint32_t n = (field->type == fr12_http_json_int && (data[field->size - 1] & 0x80)) ? 0xffffffffUL : 0;
+      for (uint8_t a = field->size; a > 0; a--) {
+        n = (n << 8) | data[a - 1];
+      }
+      if (field->type == fr12_http_json_int) {
+        this->print((int32_t)n);
+      }
+      else {
+        this->print(n);
+      }
+    }
+    break;
+
+  case fr12_http_json_string:
+    this->print_json_string((const char *)data, field->size);
+    break;
+
+  case fr12_http_json_mac:
+    this->write('"');
+    for (uint8_t a = 0; a < field->size; a++) {
+      if (a > 0) {
+        this->write(':');
+      }
+      this->print_hex(data[a]);
+    }
+    this->write('"');
+    break;
+
+  case fr12_http_json_ipv4:
+    this->write('"');
+    for (uint8_t a = 0; a < 4; a++) {
+      if (a > 0) {
+        this->write('.');
+      }
+      this->print(data[a]);
+    }
+    this->write('"');
+    break;
+
+  default:
+    this->print_P(PSTR("null"));
+    break;
+  }
+}
+
+void fr12_http_writer::print_json_string(const char *str, size_t len) {
+  // Open this string
+  this->write('"');
+
+  // Loop through the string, stopping at the bound or the NUL
+  for (size_t a = 0; a < len && str[a] != '\0'; a++) {
+    switch (str[a]) {
+      case '"':
+      case '\\':
+      case '/':
+        // Designed to fall through so we write the slash and THEN the character
+        this->write('\\');
+      default:
+        // ... or, just the character
+        this->write(str[a]);
+        break;
+      case '\b':
+        this->print_P(PSTR("\\b"));
+        break;
+      case '\f':
+        this->print_P(PSTR("\\f"));
+        break;
+      case '\n':
+        this->print_P(PSTR("\\n"));
+        break;
+      case '\r':
+        this->print_P(PSTR("\\r"));
+        break;
+      case '\t':
+        this->print_P(PSTR("\\t"));
+        break;
+    }
+  }
+
+  // Close out this string
+  this->write('"');
+}
+
+void fr12_http_writer::print_hex(uint8_t c) {
+  static const char digits[] PROGMEM = "0123456789abcdef";
+  this->write(pgm_read_byte(&digits[c >> 4]));
+  this->write(pgm_read_byte(&digits[c & 0x0f]));
+}
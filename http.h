@@ -0,0 +1,163 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#ifndef FR12_HTTP_H
+#define FR12_HTTP_H
+
+#include "defs.h"
+
+// Built-in classes
+class EthernetClient;
+
+// FR 12 classes
+class fr12_http_parser;
+class fr12_http_writer;
+
+// FR 12 structs
+struct fr12_http_json_field;
+struct fr12_http_json_object;
+
+// Limits
+enum {
+  fr12_http_max_method_len = 7,
+  fr12_http_max_target_len = 128,
+  fr12_http_writer_buffer_len = 128,
+  fr12_http_json_name_len = 14
+};
+
+// Parser states
+enum {
+  fr12_http_state_method = 0,
+  fr12_http_state_target,
+  fr12_http_state_version,
+  fr12_http_state_line_end,
+  fr12_http_state_header_start,
+  fr12_http_state_header_name,
+  fr12_http_state_header_value,
+  fr12_http_state_headers_end,
+  fr12_http_state_done,
+  fr12_http_state_error
+};
+
+// Methods
+enum {
+  fr12_http_method_unknown = 0,
+  fr12_http_method_get
+};
+
+// JSON field types
+enum {
+  fr12_http_json_uint = 0,
+  fr12_http_json_string,
+  fr12_http_json_mac,
+  fr12_http_json_ipv4,
+  fr12_http_json_int
+};
+
+// Describes one member of a packed struct: its JSON name, how to print it,
+// and where it lives. Schemas are arrays of these in PROGMEM.
+struct fr12_http_json_field {
+  char name[fr12_http_json_name_len];
+  uint8_t type;
+  uint8_t offset;
+  uint8_t size;
+};
+
+#define FR12_HTTP_JSON_FIELD(name, type, s, member) { name, type, offsetof(s, member), sizeof(((s *)0)->member) }
+
+// A struct and the schema that describes it
+struct fr12_http_json_object {
+  const fr12_http_json_field *fields;
+  uint8_t field_count;
+  const void *data;
+};
+
+// A parsed request. Path and query are NUL-terminated spans of the parser's buffer.
+struct fr12_http_request {
+  uint8_t method;
+  char *path;
+  uint8_t path_len;
+  char *query;
+  uint8_t query_len;
+  uint8_t header_count;
+};
+
+class fr12_http_parser {
+public:
+  // Constructor
+  fr12_http_parser();
+
+  // Destructor
+  virtual ~fr12_http_parser();
+
+  // Starts over with a new request
+  void reset();
+
+  // Feeds bytes in; returns how many were used. Stops once done or in error.
+  size_t consume(const uint8_t *data, size_t len);
+
+  // Getters
+  uint8_t get_state();
+  uint16_t get_error();
+  fr12_http_request *get_request();
+private:
+  // Fails with an HTTP response code
+  void fail(uint16_t code);
+
+  // Parser state, and index within the current token
+  uint8_t state, index;
+
+  // Response code when in error
+  uint16_t error;
+
+  // Offset of the query within the buffer (0 when there is none)
+  uint8_t query_offset;
+
+  // Request target, with the '?' replaced by a NUL
+  char buffer[fr12_http_max_target_len + 1];
+
+  // The request handed out once done
+  fr12_http_request request;
+};
+
+// Stages response bytes so each write() to the W5100 is one large burst
+class fr12_http_writer : public Print {
+public:
+  // Constructor
+  fr12_http_writer(EthernetClient *client);
+
+  // Destructor (flushes)
+  virtual ~fr12_http_writer();
+
+  // Print interface
+  virtual size_t write(uint8_t c);
+  virtual size_t write(const uint8_t *data, size_t len);
+  using Print::write;
+
+  // Copies a NUL-terminated flash string straight into the buffer
+  size_t print_P(PGM_P str);
+  size_t println_P(PGM_P str);
+
+  // Prints "name":value pairs for every field in a schema, comma separated
+  void print_json(const fr12_http_json_object *object);
+
+  // Prints a quoted, escaped JSON string of at most len bytes
+  void print_json_string(const char *str, size_t len);
+
+  // Sends whatever is staged
+  void flush();
+private:
+  void print_json_field(const fr12_http_json_field *field, const uint8_t *data);
+  void print_hex(uint8_t c);
+
+  EthernetClient *client;
+  uint8_t length;
+
+  // Only one response is ever being written, so the buffer is shared
+  static uint8_t buffer[fr12_http_writer_buffer_len];
+};
+
+#endif /* FR12_HTTP_H */
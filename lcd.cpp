@@ -77,7 +77,7 @@ void fr12_lcd::set_message(fr12_lcd_message *message) {
 void fr12_lcd::print_wrap(char *msg) {
   // Copy the message string
   size_t len = strlen(msg);
-  char *c = (char *)malloc(len);
+  char *c = (char *)malloc(len + 1);
   strcpy(c, msg);
 
   // Start tokenizing
@@ -9,7 +9,7 @@
 
 #include "defs.h"
 
-#include "../../../../libraries/LiquidCrystal/LiquidCrystal.h"
+#include <LiquidCrystal.h>
 
 // Built-in classes
 class LiquidCrystal;
@@ -10,24 +10,35 @@
 extern EthernetClass Ethernet;
 
 const uint16_t fr12_net::http_codes[] = {
-  200, 400, 403, 404, 413, 500};
+  200, 400, 403, 404, 405, 408, 413, 414, 500};
 const char fr12_net::http_response_ok[] = "OK";
 const char fr12_net::http_response_bad_request[] = "Bad Request";
 const char fr12_net::http_response_forbidden[] = "Forbidden";
 const char fr12_net::http_response_not_found[] = "Not Found";
+const char fr12_net::http_response_method_not_allowed[] = "Method Not Allowed";
+const char fr12_net::http_response_timeout[] = "Request Timeout";
 const char fr12_net::http_response_too_large[] = "Request Entity Too Large";
+const char fr12_net::http_response_uri_too_long[] = "Request-URI Too Long";
 const char fr12_net::http_response_server_error[] = "Internal Server Error";
 const char *fr12_net::http_responses[] = {
-  http_response_ok, http_response_bad_request, http_response_forbidden, http_response_not_found, http_response_too_large, http_response_server_error};
+  http_response_ok, http_response_bad_request, http_response_forbidden, http_response_not_found, http_response_method_not_allowed, http_response_timeout, http_response_too_large, http_response_uri_too_long, http_response_server_error};
 
 fr12_net::fr12_net() {
   this->hw = &Ethernet;
   this->http = new EthernetServer(fr12_net_http_port);
+  this->http_handler = NULL;
+  this->lease_expires = 0;
+  this->lease_state = fr12_net_lease_none;
+  this->relinks = 0;
+  this->address = 0;
+  this->supervised = 0;
+  this->dhcp_tried = 0;
+  this->dhcp_retry = fr12_net_dhcp_retry;
+  memset(&this->http_connections, 0x00, sizeof(this->http_connections));
 }
 
 fr12_net::~fr12_net() {
   delete this->http;
-  delete this->http_buffer;
 }
 
 void fr12_net::begin(fr12_union_station *union_station) {
@@ -39,7 +50,31 @@ uint8_t fr12_net::begin_ethernet_dhcp() {
   pinMode(53, OUTPUT);
 
   // DHCP us an IP
-  return this->hw->begin(mac);
+  this->dhcp_tried = millis();
+  if (this->hw->begin(this->mac, fr12_net_dhcp_timeout, fr12_net_dhcp_response_timeout) == 0) {
+    return 0;
+  }
+
+  this->lease_state = fr12_net_lease_bound;
+  this->address = this->hw->localIP();
+  this->dhcp_retry = fr12_net_dhcp_retry;
+  return 1;
+}
+
+uint8_t fr12_net::begin_ethernet_lease(uint32_t now) {
+  // Only for DHCP, and only while the lease lasts
+  if (!(this->flags & fr12_net_use_dhcp) || this->lease_expires <= now) {
+    return 0;
+  }
+
+  // SS pin
+  pinMode(53, OUTPUT);
+
+  // Come straight back up on the leased address
+  this->hw->begin(this->mac, this->lease_ip, this->lease_dns, this->lease_gateway, this->lease_subnet);
+  this->lease_state = fr12_net_lease_cached;
+  this->address = this->hw->localIP();
+  return 1;
 }
 
 void fr12_net::begin_ethernet_static() {
@@ -48,19 +83,94 @@ void fr12_net::begin_ethernet_static() {
 
   // Use a static IP
   this->hw->begin(mac, ip, dns, gateway, subnet);
+  this->lease_state = (this->flags & fr12_net_use_dhcp) ? fr12_net_lease_expired : fr12_net_lease_none;
+  this->address = this->hw->localIP();
 }
 
 void fr12_net::begin_http(fr12_http_callback handler) {
   // Start the HTTP server
   this->http->begin();
-
-  // Set up the HTTP buffer
-  this->http_buffer_len = fr12_net_http_min_buffer_len;
-  this->http_buffer_index = 0;
-  this->http_buffer = (uint8_t *)calloc(this->http_buffer_len, sizeof(uint8_t));
   this->http_handler = handler;
 }
 
+uint8_t fr12_net::supervise(uint32_t now, uint8_t synced) {
+  uint8_t events = 0;
+
+  if (millis() - this->supervised < fr12_net_supervise_interval) {
+    return 0;
+  }
+  this->supervised = millis();
+
+  // The W5100 has no link status register, but a chip that was reset under
+  // us (brownout, PHY lockup) forgets its address
+  if ((uint32_t)this->hw->localIP() != this->address) {
+    return this->relink(now);
+  }
+
+  switch (this->lease_state) {
+  case fr12_net_lease_bound:
+    // The library renews at T1 and rebinds at T2 on its own schedule
+    switch (this->hw->maintain()) {
+    case DHCP_CHECK_RENEW_OK:
+    case DHCP_CHECK_REBIND_OK:
+      this->address = this->hw->localIP();
+      events |= fr12_net_event_lease;
+      break;
+    case DHCP_CHECK_REBIND_FAIL:
+      this->lease_state = fr12_net_lease_expired;
+      break;
+    }
+    break;
+  case fr12_net_lease_cached:
+    // The journal stands still while the power's off, so only a clock NTP
+    // has set can say the lease is over. Until then the cached address
+    // stays up while the server is asked for a fresh lease, first thing
+    // after boot and then on the same backoff as below.
+    if (synced && this->lease_expires <= now) {
+      this->lease_expires = 0;
+      events |= fr12_net_event_lease;
+    }
+    else if (this->dhcp_tried != 0 && millis() - this->dhcp_tried < this->dhcp_retry * 1000UL) {
+      break;
+    }
+    events |= this->relink(now);
+    if (this->lease_state != fr12_net_lease_bound) {
+      this->dhcp_retry = this->dhcp_retry * 2 > fr12_net_dhcp_retry_max ? fr12_net_dhcp_retry_max : this->dhcp_retry * 2;
+    }
+    break;
+  case fr12_net_lease_expired:
+    // Every try blocks everything else for up to the DHCP timeout, so a
+    // server that stays away gets asked less and less often
+    if (millis() - this->dhcp_tried >= this->dhcp_retry * 1000UL) {
+      events |= this->relink(now);
+      if (this->lease_state != fr12_net_lease_bound) {
+        this->dhcp_retry = this->dhcp_retry * 2 > fr12_net_dhcp_retry_max ? fr12_net_dhcp_retry_max : this->dhcp_retry * 2;
+      }
+    }
+    break;
+  }
+
+  return events;
+}
+
+uint8_t fr12_net::relink(uint32_t now) {
+  uint8_t events = fr12_net_event_relink;
+
+  // Get a fresh lease, or come back up on whatever address still works
+  if ((this->flags & fr12_net_use_dhcp) && this->begin_ethernet_dhcp()) {
+    events |= fr12_net_event_lease;
+  }
+  else if (!this->begin_ethernet_lease(now)) {
+    this->begin_ethernet_static();
+  }
+
+  // Every socket went with the old chip state. The server listens again on
+  // its own.
+  memset(&this->http_connections, 0x00, sizeof(this->http_connections));
+  this->relinks++;
+  return events;
+}
+
 void fr12_net::get_addresses(IPAddress *addresses) {
   addresses[0] = this->hw->localIP();
   addresses[1] = this->hw->dnsServerIP();
@@ -104,214 +214,202 @@ void fr12_net::serialize(fr12_net_serialized *ee) {
   ee->subnet = this->subnet;
 }
 
+void fr12_net::configure_lease(fr12_net_lease_serialized *ee) {
+  this->lease_ip = IPAddress(ee->ip);
+  this->lease_dns = IPAddress(ee->dns);
+  this->lease_gateway = IPAddress(ee->gateway);
+  this->lease_subnet = IPAddress(ee->subnet);
+  this->lease_expires = ee->expires;
+}
+
+void fr12_net::serialize_lease(fr12_net_lease_serialized *ee, uint32_t expires) {
+  // Whatever the hardware has now is the lease
+  ee->ip = this->hw->localIP();
+  ee->dns = this->hw->dnsServerIP();
+  ee->gateway = this->hw->gatewayIP();
+  ee->subnet = this->hw->subnetMask();
+
+  // ... unless it's the static fallback, which isn't one
+  ee->expires = this->lease_state == fr12_net_lease_bound ? expires : 0;
+}
+
+void fr12_net::serialize_status(fr12_net_status *status) {
+  status->lease = this->lease_state;
+  status->lease_expires = this->lease_expires;
+  status->address = this->hw->localIP();
+  status->relinks = this->relinks;
+}
+
 void fr12_net::handle_http() {
-  // Process HTTP
-  EthernetClient http_client = this->http->available();
-
-  if (http_client) {
-    size_t length = http_client.available();
-    register uint8_t last = 0x00;
-
-    // Read all bytes from the ethernet card, resizing the buffer as needed
-    while (length > 0) {
-      uint8_t incoming = http_client.read();
-      if (this->http_buffer_index >= this->http_buffer_len) {
-        if (this->http_buffer_index < fr12_net_http_max_buffer_len) {
-          size_t new_buffer_len = this->http_buffer_len + length + 1;
-          uint8_t *new_buffer = (uint8_t *)realloc(this->http_buffer, new_buffer_len);
-          if (new_buffer == NULL) {
-            // Request Entity Too Large
-            this->http_respond(&http_client, 413);
-          } 
-          else {
-            this->http_buffer = new_buffer;
-            this->http_buffer_len = new_buffer_len;
-          }
-        } 
-        else {
-          // Request Entity Too Large
-          this->http_respond(&http_client, 413);
-        }
-      }
+  // Nothing to serve until begin_http()
+  if (this->http_handler == NULL) {
+    return;
+  }
 
-      // Save the incoming byte
-      this->http_buffer[this->http_buffer_index] = incoming;
-
-      // Check for line endings
-      if (incoming == '\n' && last == '\r') {
-        uint8_t *start = NULL;
-        if (strstr_P((const char *)this->http_buffer, PSTR("GET ")) == (const char *)this->http_buffer) {
-          uint8_t *end;
-          start = this->http_buffer + 4;
-          end = (uint8_t *)strstr_P((const char *)start, PSTR(" HTTP/1.1"));
-          if (end != NULL) {
-            *end = '\0';
-            ((this->union_station)->*(this->http_handler))(&http_client, (char *)start);
-          } 
-          else {
-            // Bad request
-            this->http_respond(&http_client, 400);
-          }
-        }
-
-        this->http_buffer_index = 0;
-      } 
-      else {
-        this->http_buffer_index++;
-      }
+  // Give every connection a turn
+  for (uint8_t sock = 0; sock < MAX_SOCK_NUM; sock++) {
+    this->http_service(sock);
+  }
+
+  // Reap closed sockets and keep one listening. Done after servicing so a
+  // socket is never reused under a slot that still holds old state.
+  this->http->available();
+}
+
+void fr12_net::http_service(uint8_t sock) {
+  fr12_net_connection *conn = &this->http_connections[sock];
+  EthernetClient http_client(sock);
+  uint8_t status = http_client.status();
+
+  // HTTP is the only TCP user, so any connected socket is one of ours
+  if (status != SnSR::ESTABLISHED && status != SnSR::CLOSE_WAIT) {
+    conn->active = 0;
+    return;
+  }
+
+  // New connection
+  if (!conn->active) {
+    conn->parser.reset();
+    conn->last_active = millis();
+    conn->active = 1;
+  }
+
+  // At most one chunk per connection per pass
+  int length = http_client.available();
+  if (length > 0) {
+    uint8_t chunk[fr12_net_http_chunk_len];
+    if (length > (int)sizeof(chunk)) {
+      length = sizeof(chunk);
+    }
 
-      length = http_client.available();
-      last = incoming;
+    length = http_client.read(chunk, length);
+    if (length > 0) {
+      conn->parser.consume(chunk, length);
+      conn->last_active = millis();
     }
+  }
 
-    http_client.stop();
+  switch (conn->parser.get_state()) {
+  case fr12_http_state_done:
+    ((this->union_station)->*(this->http_handler))(&http_client, conn->parser.get_request());
+    break;
+  case fr12_http_state_error:
+    this->http_respond(&http_client, conn->parser.get_error());
+    break;
+  default:
+    // The client hung up mid-request
+    if (status == SnSR::CLOSE_WAIT && http_client.available() == 0) {
+      break;
+    }
+
+    // Or went quiet for too long
+    if (millis() - conn->last_active >= fr12_net_http_timeout) {
+      this->http_respond(&http_client, 408);
+      break;
+    }
+
+    // Otherwise, wait for more
+    return;
   }
+
+  http_client.stop();
+  conn->active = 0;
 }
 
-void fr12_net::http_send_headers(EthernetClient *client, uint16_t response_code, const char *content_type, const char **headers, size_t header_length) {
+void fr12_net::http_send_headers(fr12_http_writer *out, uint16_t response_code, PGM_P content_type, const char **headers, size_t header_length) {
   // We're using HTTP 1.1. Send "HTTP/1.1 <code> <stringified code>"
-  client->print("HTTP/1.1 ");
-  client->print(response_code);
-  client->write(' ');
-  this->http_send_response(client, response_code);
-  client->println();
+  out->print_P(PSTR("HTTP/1.1 "));
+  out->print(response_code);
+  out->write(' ');
+  this->http_send_response(out, response_code);
+  out->println();
 
   // Print headers
-  client->println("Server: Froshduino/" FR12_VERSION);
+  out->println_P(PSTR("Server: Froshduino/" FR12_VERSION));
 
   if (headers != NULL) {
     for(size_t i = 0; i < header_length; i++) {
-      client->println(headers[i]); 
+      out->println(headers[i]); 
     }
   }
 
   // Print final headers
-  client->print("Content-Type: ");
-  client->println(content_type);
-  client->println("Connection: close");
-  client->println();
+  out->print_P(PSTR("Content-Type: "));
+  out->println_P(content_type);
+  out->println_P(PSTR("Connection: close\r\n"));
 }
 
-void fr12_net::http_send_response(EthernetClient *client, uint16_t response_code) {
+void fr12_net::http_send_response(fr12_http_writer *out, uint16_t response_code) {
   // Convert the response code into text
-  for (size_t a = 0; a < sizeof(this->http_codes); a++) {
+  for (size_t a = 0; a < sizeof(this->http_codes) / sizeof(this->http_codes[0]); a++) {
     uint16_t code = pgm_read_word(&this->http_codes[a]);
     if (code == response_code) {
-      // Read the pointer to the response string
-      PGM_P p = (PGM_P)pgm_read_word(&this->http_responses[a]);
-
-      // Allocate memory to hold the response
-      size_t len = strlen_P(p);
-      char *code_str = (char *)calloc(len + 1, sizeof(char));
-
-      // Copy the data at the pointer into the buffer
-      strncpy_P(code_str, p, len);
-
-      // Print the code string
-      client->print(code_str);
-
-      // Free memory
-      free(code_str);
+      // Stream the response string straight out of flash
+      out->print_P((PGM_P)pgm_read_word(&this->http_responses[a]));
       break;
     }
   }
 }
 
 void fr12_net::http_respond(EthernetClient *client, uint16_t response_code, const char *data, size_t data_length, const char **headers, size_t header_length) {
-  this->http_send_headers(client, response_code, "text/html", headers, header_length);
-  if (data_length == 0) {
+  fr12_http_writer out_writer(client), *out = &out_writer;
+
+  this->http_send_headers(out, response_code, PSTR("text/html"), headers, header_length);
+  if (data != NULL && data_length == 0) {
     data_length = strlen(data);
   }
 
   // Print data
   if (data != NULL) {
-    for(size_t i = 0; i < data_length; i++) {
-      client->write(data[i]);
-    }
+    out->write((const uint8_t *)data, data_length);
   } 
   else {
-    client->print("<h1>");
-    client->print(response_code);
-    client->print(" - ");
-    this->http_send_response(client, response_code);
-    client->print("</h1>");
+    out->print_P(PSTR("<h1>"));
+    out->print(response_code);
+    out->print_P(PSTR(" - "));
+    this->http_send_response(out, response_code);
+    out->print_P(PSTR("</h1>"));
   }
 
-  client->println();
+  out->println();
+  out->flush();
   client->flush();
   client->stop();
 }
 
-void fr12_net::http_respond_json(EthernetClient *client, uint16_t response_code, const char **data, size_t data_length, const char **headers, size_t header_length) {
+void fr12_net::http_respond_json(EthernetClient *client, uint16_t response_code, const fr12_http_json_object *objects, size_t object_count, const char **headers, size_t header_length) {
+  fr12_http_writer out_writer(client), *out = &out_writer;
+
   // Send headers
-  this->http_send_headers(client, response_code, "application/json", headers, header_length);
+  this->http_send_headers(out, response_code, PSTR("application/json"), headers, header_length);
 
   // Print out the version with the data
-  client->print("{\"version\":\"" FR12_VERSION "\",\"data\":");
-
-  if (data != NULL) {
-    // Open the array
-    client->write('[');
-
-    for(size_t i = 0; i < data_length; i++) {
-      // The length of the current data entry
-      size_t sz = strlen(data[i]);
-
-      // Open this string
-      client->write('"');
-
-      // Loop through the current string
-      for (size_t k = 0; k < sz; k++) {
-        switch (data[i][k]) {
-          case '"':
-          case '\\':
-          case '/':
-            // Designed to fall through so we write the slash and THEN the character
-            client->write('\\');
-          default:
-            // ... or, just the character
-            client->write(data[i][k]);
-            break;
-          case '\b':
-            client->print("\\b");
-            break;
-          case '\f':
-            client->print("\\f");
-            break;
-          case '\n':
-            client->print("\\n");
-            break;
-          case '\r':
-            client->print("\\r");
-            break;
-          case '\t':
-            client->print("\\t");
-            break;
-        }
-      }
+  out->print_P(PSTR("{\"version\":\"" FR12_VERSION "\",\"data\":"));
 
-      // Close out this string
-      client->write('"');
+  if (objects != NULL) {
+    // Every object's fields go into one JSON object
+    out->write('{');
 
-      // Comma, possibly?
-      if (i < data_length - 1) {
-        client->write(',');
+    for (size_t i = 0; i < object_count; i++) {
+      if (i > 0) {
+        out->write(',');
       }
+      out->print_json(&objects[i]);
     }
 
-    // Close out the array
-    client->write(']');
+    out->write('}');
   } 
   else {
     // Just print the HTTP response code if there's no data
-    client->print(response_code);
+    out->print(response_code);
   }
 
   // Close out the JSON blob
-  client->write('}');
+  out->write('}');
 
   // ... and, we're done
-  client->println();
+  out->println();
+  out->flush();
   client->flush();
   client->stop();
 }
@@ -8,15 +8,16 @@
 #define FR12_NET_H
 
 #include "defs.h"
+#include "http.h"
 
-#include "../../../../libraries/SPI/SPI.h"
-#include "../../../../libraries/Ethernet/Dhcp.h"
-#include "../../../../libraries/Ethernet/Dns.h"
-#include "../../../../libraries/Ethernet/Ethernet.h"
-#include "../../../../libraries/Ethernet/EthernetClient.h"
-#include "../../../../libraries/Ethernet/EthernetServer.h"
-#include "../../../../libraries/Ethernet/EthernetUdp.h"
-#include "../../../../libraries/Ethernet/util.h"
+#include <SPI.h>
+#include <Dhcp.h>
+#include <Dns.h>
+#include <Ethernet.h>
+#include <EthernetClient.h>
+#include <EthernetServer.h>
+#include <EthernetUdp.h>
+#include <util.h>
 
 // Built-in classes
 class EthernetClass;
@@ -29,15 +30,48 @@ class fr12_config;
 
 // Serialization structs
 struct fr12_net_serialized;
+struct fr12_net_lease_serialized;
 
 // HTTP handler callback
-typedef void (fr12_union_station::*fr12_http_callback)(EthernetClient *, char *);
+typedef void (fr12_union_station::*fr12_http_callback)(EthernetClient *, fr12_http_request *);
 
 // Defaults
 enum {
   fr12_net_http_port = 80,
-  fr12_net_http_min_buffer_len = 64,
-  fr12_net_http_max_buffer_len = 256,
+  fr12_net_http_chunk_len = 64,
+  fr12_net_http_timeout = 2000,
+
+  // The Ethernet library keeps the lease time to itself, so cached leases
+  // are saved as lasting this many seconds. A cached lease bridges the boot
+  // until the server answers again. The library can't ask for a known
+  // address (INIT-REBOOT), so the supervisor sends a fresh DISCOVER, which
+  // most servers answer with the same address.
+  fr12_net_lease_time = 3600,
+
+  // DHCP attempts give up after this long, so a dead server doesn't stall
+  // loop() for the library's default minute
+  fr12_net_dhcp_timeout = 4000,
+  fr12_net_dhcp_response_timeout = 1000,
+
+  // How often the supervisor runs (ms), and how long it waits (s) before
+  // retrying failed DHCP: the wait doubles after each failure, up to a cap
+  fr12_net_supervise_interval = 1000,
+  fr12_net_dhcp_retry = 60,
+  fr12_net_dhcp_retry_max = 3600
+};
+
+// Lease states
+enum {
+  fr12_net_lease_none = 0,
+  fr12_net_lease_cached,
+  fr12_net_lease_bound,
+  fr12_net_lease_expired
+};
+
+// What the supervisor did
+enum {
+  fr12_net_event_lease = (1 << 0),
+  fr12_net_event_relink = (1 << 1)
 };
 
 // Flags
@@ -45,6 +79,22 @@ enum {
   fr12_net_use_dhcp = (1 << 0)
 };
 
+// Lease and link status, reported under /get/net
+struct fr12_net_status {
+  uint8_t lease;
+  uint32_t lease_expires;
+  uint32_t address;
+  uint16_t relinks;
+}
+__attribute__ ((packed));
+
+// Per-socket HTTP connection state
+struct fr12_net_connection {
+  fr12_http_parser parser;
+  uint32_t last_active;
+  uint8_t active;
+};
+
 class fr12_net {
 public:
   // Constructor
@@ -58,11 +108,17 @@ public:
   
   // Starts up Ethernet
   uint8_t begin_ethernet_dhcp();
+  uint8_t begin_ethernet_lease(uint32_t now);
   void begin_ethernet_static();
   
   // Starts up HTTP
   void begin_http(fr12_http_callback handler);
   
+  // Keeps the lease and the link up. A cached lease is only given up once
+  // it has run out by a clock NTP has set (synced). Returns fr12_net_event_*
+  // flags.
+  uint8_t supervise(uint32_t now, uint8_t synced);
+  
   // Gets addresses, subnet mask, etc
   void get_addresses(IPAddress *addresses);
   uint8_t *get_mac();
@@ -71,15 +127,19 @@ public:
   // Configuration
   void configure(fr12_net_serialized *ee);
   void serialize(fr12_net_serialized *ee);
+  void configure_lease(fr12_net_lease_serialized *ee);
+  void serialize_lease(fr12_net_lease_serialized *ee, uint32_t expires);
+  void serialize_status(fr12_net_status *status);
   
   // HTTP utilities
   void handle_http();
   void http_respond(EthernetClient *client, uint16_t response_code, const char *data = NULL, size_t data_length = 0, const char **headers = NULL, size_t header_length = 0);
-  void http_respond_json(EthernetClient *client, uint16_t response_code, const char **data = NULL, size_t data_length = 0, const char **headers = NULL, size_t header_length = 0);
+  void http_respond_json(EthernetClient *client, uint16_t response_code, const fr12_http_json_object *objects = NULL, size_t object_count = 0, const char **headers = NULL, size_t header_length = 0);
   void http_unescape(char *s);
 private:
-  void http_send_headers(EthernetClient *client, uint16_t response_code, const char *content_type, const char **headers = NULL, size_t header_length = 0);
-  void http_send_response(EthernetClient *client, uint16_t response_code);
+  void http_send_headers(fr12_http_writer *out, uint16_t response_code, PGM_P content_type, const char **headers = NULL, size_t header_length = 0);
+  void http_send_response(fr12_http_writer *out, uint16_t response_code);
+  void http_service(uint8_t sock);
   int http_unhex(char c);
   
   static const uint16_t http_codes[] PROGMEM;
@@ -87,7 +147,10 @@ private:
   static const char http_response_bad_request[] PROGMEM;
   static const char http_response_forbidden[] PROGMEM;
   static const char http_response_not_found[] PROGMEM;
+  static const char http_response_method_not_allowed[] PROGMEM;
+  static const char http_response_timeout[] PROGMEM;
   static const char http_response_too_large[] PROGMEM;
+  static const char http_response_uri_too_long[] PROGMEM;
   static const char http_response_server_error[] PROGMEM;
   static const char *http_responses[] PROGMEM;
   
@@ -95,13 +158,22 @@ private:
   uint8_t flags;
   uint8_t mac[6];
   IPAddress ip, dns, gateway, subnet;
+  
+  // Cached DHCP lease
+  IPAddress lease_ip, lease_dns, lease_gateway, lease_subnet;
+  uint32_t lease_expires;
+  
+  // Supervisor
+  uint8_t lease_state;
+  uint16_t relinks, dhcp_retry;
+  uint32_t address, supervised, dhcp_tried;
+  uint8_t relink(uint32_t now);
   EthernetClass *hw;
   fr12_union_station *union_station;
   
   // HTTP members
   EthernetServer *http;
-  uint8_t *http_buffer;
-  size_t http_buffer_len, http_buffer_index;
+  fr12_net_connection http_connections[MAX_SOCK_NUM];
   fr12_http_callback http_handler;
 };
 
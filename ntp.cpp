@@ -6,28 +6,240 @@
 
 #include "ntp.h"
 #include "config.h"
+#include "time.h"
 
 fr12_ntp::fr12_ntp() {
-  memset(&this->hostname, 0x00, fr12_ntp_hostname_size);
+  memset(&this->peers, 0x00, sizeof(this->peers));
+  this->time = NULL;
+  this->state = fr12_ntp_idle;
+  this->tries = this->rounds = this->index = 0;
+  this->since = this->timeout = this->finished = 0;
+  this->selected = fr12_ntp_none;
+  this->survivors = 0;
 }
 
 fr12_ntp::~fr12_ntp() {
   
 }
 
-void fr12_ntp::begin(IPAddress &dns) {
-  DNSClient dns_client;
-  dns_client.begin(dns);
-  int err = dns_client.getHostByName((const char *)&this->hostname, this->addr);
-  if (err != 1) {
-    memcpy_P(&this->hostname, PSTR("time.nist.gov"), 28);
-    this->addr = IPAddress(192, 43, 244, 18); // time.nist.gov
+void fr12_ntp::begin(IPAddress &dns, fr12_time *time) {
+  // Servers are looked up when the first round starts
+  this->dns = dns;
+  this->time = time;
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    this->peers[a].addr = IPAddress(0, 0, 0, 0);
   }
   this->udp.begin(fr12_ntp_local_port);
 }
 
+void fr12_ntp::restart() {
+  this->udp.stop();
+  this->udp.begin(fr12_ntp_local_port);
+}
+
+void fr12_ntp::sync() {
+  if (this->state != fr12_ntp_idle) {
+    return;
+  }
+  if (this->rounds > 0 && millis() - this->finished < fr12_ntp_min_interval * 1000UL) {
+    return;
+  }
+
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    this->peers[a].answered = 0;
+  }
+  this->tries = this->index = 0;
+  this->timeout = fr12_ntp_timeout;
+  this->state = fr12_ntp_resolve;
+}
+
+uint8_t fr12_ntp::poll(fr12_ntp_sample *sample) {
+  switch (this->state) {
+  case fr12_ntp_resolve:
+    // Skip empty slots and servers we already have. Look up one server a
+    // call, since each lookup blocks.
+    while (this->index < fr12_ntp_peers && (this->peers[this->index].hostname[0] == '\0' || (uint32_t)this->peers[this->index].addr != 0)) {
+      this->index++;
+    }
+    if (this->index < fr12_ntp_peers) {
+      this->resolve(&this->peers[this->index++]);
+    }
+    else {
+      this->state = fr12_ntp_send;
+    }
+    break;
+  case fr12_ntp_send: {
+    uint8_t sent = 0;
+
+    // Out of tries. Go with whoever answered.
+    if (this->tries == fr12_ntp_max_tries) {
+      return this->finish(sample);
+    }
+
+    // Ask every server that hasn't answered yet
+    for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+      if ((uint32_t)this->peers[a].addr != 0 && !this->peers[a].answered) {
+        this->send_packet(a);
+        sent++;
+      }
+    }
+    if (sent == 0) {
+      return this->finish(sample);
+    }
+
+    this->tries++;
+    this->since = millis();
+    this->state = fr12_ntp_await;
+    return fr12_ntp_event_sent;
+  }
+  case fr12_ntp_await: {
+    uint8_t pending = 0, answered = 0;
+
+    while (this->udp.parsePacket()) {
+      // T4, as close to arrival as we can get it
+      uint64_t received = this->local_timestamp();
+      uint8_t a = this->validate();
+
+      if (a != fr12_ntp_none) {
+        // T1 sent, T2 server received, T3 server sent, T4 received
+        fr12_ntp_peer *peer = &this->peers[a];
+        uint64_t t2 = read_timestamp(&this->buffer[32]);
+        uint64_t t3 = read_timestamp(&this->buffer[40]);
+        peer->sample.offset = ((int64_t)(t2 - peer->sent) + (int64_t)(t3 - received)) / 2;
+        peer->sample.delay = (int64_t)(received - peer->sent) - (int64_t)(t3 - t2);
+        peer->answered = 1;
+      }
+    }
+
+    for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+      if ((uint32_t)this->peers[a].addr == 0) {
+        continue;
+      }
+      if (this->peers[a].answered) {
+        answered++;
+      }
+      else {
+        pending++;
+      }
+    }
+
+    // Done once everyone has answered, or a majority has and the rest are
+    // late
+    if (pending == 0) {
+      return this->finish(sample);
+    }
+    if (millis() - this->since >= this->timeout) {
+      if (answered > pending) {
+        return this->finish(sample);
+      }
+
+      // Back off before the next try
+      this->timeout = this->timeout * 2 > fr12_ntp_timeout_max ? (uint32_t)fr12_ntp_timeout_max : this->timeout * 2;
+      this->state = fr12_ntp_send;
+    }
+    break;
+  }
+  }
+
+  return fr12_ntp_event_none;
+}
+
+uint8_t fr12_ntp::finish(fr12_ntp_sample *sample) {
+  // Servers that never answered get looked up again next round
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    fr12_ntp_peer *peer = &this->peers[a];
+    peer->reach = peer->reach << 1 | peer->answered;
+    if (!peer->answered) {
+      peer->addr = IPAddress(0, 0, 0, 0);
+    }
+  }
+
+  this->state = fr12_ntp_idle;
+  this->finished = millis();
+  this->rounds++;
+  return this->select(sample) ? fr12_ntp_event_synced : fr12_ntp_event_failed;
+}
+
+uint8_t fr12_ntp::select(fr12_ntp_sample *sample) {
+  int64_t lo[fr12_ntp_peers], hi[fr12_ntp_peers], edge[fr12_ntp_peers * 2];
+  int8_t step[fr12_ntp_peers * 2];
+  int64_t best_lo = 0, best_hi = 0;
+  uint8_t n = 0, answered = 0, count = 0, best = 0;
+
+  this->selected = fr12_ntp_none;
+  this->survivors = 0;
+
+  // Each answer puts the true offset within half its delay, plus a
+  // millisecond for our clock's resolution. Ends are kept sorted, starts
+  // before ends on a tie so touching intervals overlap.
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    fr12_ntp_peer *peer = &this->peers[a];
+    if (!peer->answered) {
+      continue;
+    }
+
+    int64_t half = (peer->sample.delay > 0 ? peer->sample.delay / 2 : 0) + (((int64_t)1 << 32) / 1000);
+    lo[a] = peer->sample.offset - half;
+    hi[a] = peer->sample.offset + half;
+    answered++;
+
+    for (uint8_t e = 0; e < 2; e++) {
+      int64_t v = e == 0 ? lo[a] : hi[a];
+      int8_t d = e == 0 ? 1 : -1;
+      uint8_t b = n++;
+      while (b > 0 && (edge[b - 1] > v || (edge[b - 1] == v && step[b - 1] < d))) {
+        edge[b] = edge[b - 1];
+        step[b] = step[b - 1];
+        b--;
+      }
+      edge[b] = v;
+      step[b] = d;
+    }
+  }
+
+  // Marzullo: sweep the ends and keep the stretch the most intervals share
+  for (uint8_t b = 0; b < n; b++) {
+    count += step[b];
+    if (step[b] > 0 && count > best) {
+      best = count;
+      best_lo = edge[b];
+      best_hi = edge[b + 1];
+    }
+  }
+
+  // Without a majority there's no telling who's right
+  if (best * 2 <= answered) {
+    return 0;
+  }
+
+  // Servers that overlap the shared stretch are truechimers; the rest are
+  // falsetickers. The one with the shortest round trip is the best.
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    fr12_ntp_peer *peer = &this->peers[a];
+    if (!peer->answered || lo[a] > best_hi || hi[a] < best_lo) {
+      continue;
+    }
+
+    this->survivors++;
+    if (this->selected == fr12_ntp_none || peer->sample.delay < this->peers[this->selected].sample.delay) {
+      this->selected = a;
+    }
+  }
+
+  *sample = this->peers[this->selected].sample;
+  return 1;
+}
+
+void fr12_ntp::resolve(fr12_ntp_peer *peer) {
+  DNSClient dns_client;
+  dns_client.begin(this->dns);
+  if (dns_client.getHostByName((const char *)&peer->hostname, peer->addr) != 1) {
+    peer->addr = IPAddress(0, 0, 0, 0);
+  }
+}
+
 // send an NTP request to the time server at the given address 
-void fr12_ntp::send_packet() {
+void fr12_ntp::send_packet(uint8_t index) {
   // set all bytes in the buffer to 0
   memset(&this->buffer, 0x00, fr12_ntp_packet_size); 
 
@@ -41,42 +253,115 @@ void fr12_ntp::send_packet() {
   this->buffer[14]  = 49;
   this->buffer[15]  = 52;
 
+  // T1, tagged with the server in its lowest bits. The server echoes it
+  // back as the originate timestamp, which ties the reply to this request.
+  fr12_ntp_peer *peer = &this->peers[index];
+  peer->sent = (this->local_timestamp() & ~(uint64_t)(fr12_ntp_peers - 1)) | index;
+  write_timestamp(&this->buffer[40], peer->sent);
+
   // all NTP fields have been given values, now	   
-  this->udp.beginPacket(this->addr, 123); // NTP requests are to port 123
+  this->udp.beginPacket(peer->addr, fr12_ntp_server_port); // NTP requests are to port 123
   this->udp.write(this->buffer, fr12_ntp_packet_size);
   this->udp.endPacket(); 
 }
 
-uint32_t fr12_ntp::get_time() {
-  if (this->udp.parsePacket()) {
-    // Read the UDP packet
-    this->udp.read(this->buffer, fr12_ntp_packet_size);
-    
-    // Return the seconds since 1900 minus 70 years (to get the unix timestamp)
-    uint32_t hi = word(this->buffer[40], this->buffer[41]);
-    uint32_t lo = word(this->buffer[42], this->buffer[43]);
-    uint32_t secs_since_1900 = hi << 16 | lo;
-    uint32_t unix = secs_since_1900 - fr12_ntp_seventy_years;
-    
-    return unix;
+uint8_t fr12_ntp::validate() {
+  if (this->udp.remotePort() != fr12_ntp_server_port || this->udp.read(this->buffer, fr12_ntp_packet_size) != fr12_ntp_packet_size) {
+    return fr12_ntp_none;
   }
 
-  return 0;
+  // A synchronized server (not LI 3, stratum 1-15) answering in server mode
+  uint8_t li = this->buffer[0] >> 6, mode = this->buffer[0] & 0x07, stratum = this->buffer[1];
+  if (li == 3 || mode != 4 || stratum == 0 || stratum > 15) {
+    return fr12_ntp_none;
+  }
+
+  // From the server we asked, answering this request and not an older one
+  uint64_t originate = read_timestamp(&this->buffer[24]);
+  uint8_t index = originate & (fr12_ntp_peers - 1);
+  fr12_ntp_peer *peer = &this->peers[index];
+  if (peer->answered || originate != peer->sent || (uint32_t)this->udp.remoteIP() != (uint32_t)peer->addr) {
+    return fr12_ntp_none;
+  }
+  return index;
+}
+
+uint64_t fr12_ntp::local_timestamp() {
+  uint32_t seconds, fraction;
+  this->time->stamp(&seconds, &fraction);
+  return (uint64_t)(seconds + fr12_ntp_seventy_years) << 32 | fraction;
+}
+
+uint64_t fr12_ntp::read_timestamp(const uint8_t *p) {
+  uint64_t timestamp = 0;
+  for (uint8_t a = 0; a < 8; a++) {
+    timestamp = timestamp << 8 | p[a];
+  }
+  return timestamp;
+}
+
+void fr12_ntp::write_timestamp(uint8_t *p, uint64_t timestamp) {
+  for (uint8_t a = 8; a > 0; a--) {
+    p[a - 1] = timestamp & 0xff;
+    timestamp >>= 8;
+  }
+}
+
+int32_t fr12_ntp::to_us(int64_t t) {
+  if (t >= (int64_t)2147 << 32) {
+    return 2147483647L;
+  }
+  if (t <= -((int64_t)2147 << 32)) {
+    return -2147483647L;
+  }
+  return (t * 1000000) >> 32;
 }
 
 void fr12_ntp::configure(fr12_ntp_serialized *ee) {
-  memcpy(&this->hostname, ee->server, sizeof(ee->server));
+  // Servers that changed start over, and get looked up on the next round
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    fr12_ntp_peer *peer = &this->peers[a];
+    if (memcmp(&peer->hostname, ee->server[a], sizeof(ee->server[a])) != 0) {
+      memcpy(&peer->hostname, ee->server[a], sizeof(ee->server[a]));
+      memset(&peer->sample, 0x00, sizeof(peer->sample));
+      peer->addr = IPAddress(0, 0, 0, 0);
+      peer->reach = 0;
+    }
+  }
 }
 
 void fr12_ntp::serialize(fr12_ntp_serialized *ee) {
-  memcpy(ee->server, &this->hostname, sizeof(ee->server));
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    memcpy(ee->server[a], &this->peers[a].hostname, sizeof(ee->server[a]));
+  }
+}
+
+void fr12_ntp::serialize_status(fr12_ntp_status *status) {
+  status->selected = this->selected;
+  status->survivors = this->survivors;
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    fr12_ntp_peer *peer = &this->peers[a];
+    status->peer[a].address = (uint32_t)peer->addr;
+    status->peer[a].reach = peer->reach;
+    status->peer[a].offset = to_us(peer->sample.offset);
+    status->peer[a].delay = to_us(peer->sample.delay);
+  }
 }
 
-const char *fr12_ntp::get_hostname() {
-  return (const char *)&this->hostname;
+uint8_t fr12_ntp::get_peers() {
+  uint8_t n = 0;
+  for (uint8_t a = 0; a < fr12_ntp_peers; a++) {
+    if (this->peers[a].hostname[0] != '\0') {
+      n++;
+    }
+  }
+  return n;
 }
 
-IPAddress fr12_ntp::get_ip() {
-  return this->addr;
+uint8_t fr12_ntp::get_state() {
+  return this->state;
 }
 
+uint8_t fr12_ntp::get_tries() {
+  return this->tries;
+}
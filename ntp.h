@@ -9,30 +9,99 @@
 
 #include "defs.h"
 
-#include "../../../../libraries/SPI/SPI.h"
-#include "../../../../libraries/Ethernet/Dhcp.h"
-#include "../../../../libraries/Ethernet/Dns.h"
-#include "../../../../libraries/Ethernet/Ethernet.h"
-#include "../../../../libraries/Ethernet/EthernetClient.h"
-#include "../../../../libraries/Ethernet/EthernetServer.h"
-#include "../../../../libraries/Ethernet/EthernetUdp.h"
-#include "../../../../libraries/Ethernet/util.h"
+#include <SPI.h>
+#include <Dhcp.h>
+#include <Dns.h>
+#include <Ethernet.h>
+#include <EthernetClient.h>
+#include <EthernetServer.h>
+#include <EthernetUdp.h>
+#include <util.h>
 
 // Various constants
 enum {
   fr12_ntp_local_port = 8888,
+  fr12_ntp_server_port = 123,
   fr12_ntp_hostname_size = 32,
   fr12_ntp_packet_size = 48,
   fr12_ntp_seventy_years = 2208988800UL
 };
 
+// Server pool. Requests carry the server's index in the lowest bits of T1,
+// far below the clock's resolution, so peers must be a power of two.
+enum {
+  fr12_ntp_peers = 4,
+  fr12_ntp_none = 0xff
+};
+
+// Timing. Each try waits twice as long as the last, up to the max (ms).
+// Rounds start no closer together than the min interval (s).
+enum {
+  fr12_ntp_timeout = 1500,
+  fr12_ntp_timeout_max = 8000,
+  fr12_ntp_max_tries = 5,
+  fr12_ntp_min_interval = 64
+};
+
+// Sync states
+enum {
+  fr12_ntp_idle = 0,
+  fr12_ntp_resolve,
+  fr12_ntp_send,
+  fr12_ntp_await
+};
+
+// What poll() reports
+enum {
+  fr12_ntp_event_none = 0,
+  fr12_ntp_event_sent,
+  fr12_ntp_event_synced,
+  fr12_ntp_event_failed
+};
+
 // FR 12 classes
 class fr12_ntp;
 class fr12_config;
+class fr12_time;
+
+// Clock offset and round-trip delay from a sync, in 32.32 fixed-point
+// seconds. Adding offset to the local clock gives the server's time.
+struct fr12_ntp_sample {
+  int64_t offset;
+  int64_t delay;
+};
+
+// One server in the pool: where it is, the request waiting on it, and its
+// last answer
+struct fr12_ntp_peer {
+  uint8_t hostname[fr12_ntp_hostname_size];
+  IPAddress addr;
+  uint64_t sent;
+  fr12_ntp_sample sample;
+  uint8_t answered, reach;
+};
 
 // Serialization structs
 struct fr12_ntp_serialized;
 
+// Per-server stats. Reach has the last eight rounds, newest in bit 0.
+// Offset and delay are in microseconds.
+struct fr12_ntp_peer_status {
+  uint32_t address;
+  uint8_t reach;
+  int32_t offset;
+  int32_t delay;
+}
+__attribute__ ((packed));
+
+// Which server the last sync used, and how many agreed with it
+struct fr12_ntp_status {
+  uint8_t selected;
+  uint8_t survivors;
+  fr12_ntp_peer_status peer[fr12_ntp_peers];
+}
+__attribute__ ((packed));
+
 class fr12_ntp {
 public:
   // Constructor
@@ -41,27 +110,55 @@ public:
   // Destructor
   virtual ~fr12_ntp();
   
-  // Starts up NTP with a DNS server
-  void begin(IPAddress &dns);
+  // Starts up NTP with a DNS server and the clock it timestamps against
+  void begin(IPAddress &dns, fr12_time *time);
+  
+  // Reopens the UDP socket after the network comes back
+  void restart();
   
-  // Sends a packet
-  void send_packet();
+  // Starts a sync round with every server, unless one is running or the last was too recent
+  void sync();
   
-  // Gets the time
-  uint32_t get_time();
+  // Moves the round along without blocking. Returns fr12_ntp_event_*; on
+  // fr12_ntp_event_synced, sample holds the chosen server's result.
+  uint8_t poll(fr12_ntp_sample *sample);
   
   // Configuration
   void configure(fr12_ntp_serialized *ee);
   void serialize(fr12_ntp_serialized *ee);
+  void serialize_status(fr12_ntp_status *status);
   
   // Getters
-  const char *get_hostname();
-  IPAddress get_ip();
+  uint8_t get_peers();
+  uint8_t get_state();
+  uint8_t get_tries();
 private:
-  uint8_t hostname[fr12_ntp_hostname_size];
+  void resolve(fr12_ntp_peer *peer);
+  void send_packet(uint8_t index);
+  uint8_t validate();
+  uint8_t finish(fr12_ntp_sample *sample);
+  uint8_t select(fr12_ntp_sample *sample);
+  
+  // Seconds (32.32) to microseconds, pinned to what fits
+  static int32_t to_us(int64_t t);
+  
+  // NTP timestamps (seconds since 1900, 32.32)
+  uint64_t local_timestamp();
+  static uint64_t read_timestamp(const uint8_t *p);
+  static void write_timestamp(uint8_t *p, uint64_t timestamp);
+  
+  fr12_ntp_peer peers[fr12_ntp_peers];
   uint8_t buffer[fr12_ntp_packet_size];
-  IPAddress addr;
+  IPAddress dns;
   EthernetUDP udp;
+  fr12_time *time;
+  
+  // Round state
+  uint8_t state, tries, rounds, index;
+  uint32_t since, timeout, finished;
+  
+  // Outcome of the last selection
+  uint8_t selected, survivors;
 };
 
 #endif /* FR12_NTP_H */
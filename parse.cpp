@@ -0,0 +1,142 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "parse.h"
+
+// Value of a hex digit, or 0xff
+static uint8_t fr12_parse_hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+
+  return 0xff;
+}
+
+// Parses up to the first non-digit; *end points there afterwards
+static uint8_t fr12_parse_number(const char *s, uint8_t base, uint32_t max, uint32_t *value, const char **end) {
+  uint32_t n = 0;
+  const char *p;
+
+  for (p = s; ; p++) {
+    uint8_t d = fr12_parse_hex_digit(*p);
+    if (d >= base) {
+      break;
+    }
+
+    // n * base + d > max, without overflowing 32 bits
+    if (d > max || n > (max - d) / base) {
+      return fr12_parse_overflow;
+    }
+    n = n * base + d;
+  }
+
+  if (p == s) {
+    return *p == '\0' ? fr12_parse_empty : fr12_parse_invalid;
+  }
+
+  *value = n;
+  *end = p;
+  return fr12_parse_ok;
+}
+
+uint8_t fr12_parse_uint(const char *s, uint32_t max, uint32_t *value) {
+  uint8_t base = 10, ret;
+  uint32_t n;
+  const char *end;
+
+  if (s[0] == '0' && (s[1] | 0x20) == 'x') {
+    base = 16;
+    s += 2;
+  }
+
+  if ((ret = fr12_parse_number(s, base, max, &n, &end)) != fr12_parse_ok) {
+    return ret;
+  }
+  if (*end != '\0') {
+    return fr12_parse_invalid;
+  }
+
+  *value = n;
+  return fr12_parse_ok;
+}
+
+uint8_t fr12_parse_byte(const char *s, uint8_t *value) {
+  uint32_t n;
+  uint8_t ret = fr12_parse_uint(s, 0xff, &n);
+
+  if (ret == fr12_parse_ok) {
+    *value = n;
+  }
+  return ret;
+}
+
+uint8_t fr12_parse_ipv4(const char *s, uint8_t *ip) {
+  uint8_t octets[4], ret;
+
+  for (uint8_t a = 0; a < sizeof(octets); a++) {
+    uint32_t n;
+
+    if (a > 0) {
+      if (*s == '\0') {
+        return fr12_parse_too_short;
+      }
+      if (*s++ != '.') {
+        return fr12_parse_invalid;
+      }
+    }
+
+    if ((ret = fr12_parse_number(s, 10, 0xff, &n, &s)) != fr12_parse_ok) {
+      return ret == fr12_parse_empty && a > 0 ? fr12_parse_too_short : ret;
+    }
+    octets[a] = n;
+  }
+
+  if (*s != '\0') {
+    return fr12_parse_invalid;
+  }
+
+  memcpy(ip, octets, sizeof(octets));
+  return fr12_parse_ok;
+}
+
+uint8_t fr12_parse_mac(const char *s, uint8_t *mac) {
+  uint8_t bytes[6], ret;
+
+  for (uint8_t a = 0; a < sizeof(bytes); a++) {
+    uint32_t n;
+
+    if (a > 0) {
+      if (*s == '\0') {
+        return fr12_parse_too_short;
+      }
+      if (*s++ != ':') {
+        return fr12_parse_invalid;
+      }
+    }
+
+    // At most two digits per byte
+    const char *start = s;
+    if ((ret = fr12_parse_number(s, 16, 0xff, &n, &s)) != fr12_parse_ok) {
+      return ret == fr12_parse_empty && a > 0 ? fr12_parse_too_short : ret;
+    }
+    if (s - start > 2) {
+      return fr12_parse_overflow;
+    }
+    bytes[a] = n;
+  }
+
+  if (*s != '\0') {
+    return fr12_parse_invalid;
+  }
+
+  memcpy(mac, bytes, sizeof(bytes));
+  return fr12_parse_ok;
+}
@@ -0,0 +1,33 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#ifndef FR12_PARSE_H
+#define FR12_PARSE_H
+
+#include "defs.h"
+
+// Results. Parsers leave their output alone unless they return ok.
+enum {
+  fr12_parse_ok = 0,
+  fr12_parse_empty,     // nothing to parse
+  fr12_parse_invalid,   // a character that doesn't belong
+  fr12_parse_overflow,  // a number or field too big for its destination
+  fr12_parse_too_short  // fewer fields than required
+};
+
+// Unsigned integer, decimal or "0x" hex, no greater than max
+uint8_t fr12_parse_uint(const char *s, uint32_t max, uint32_t *value);
+
+// Unsigned byte (RGB levels, flags)
+uint8_t fr12_parse_byte(const char *s, uint8_t *value);
+
+// Dotted quad, into four bytes in IPAddress order
+uint8_t fr12_parse_ipv4(const char *s, uint8_t *ip);
+
+// Six colon-separated hex bytes
+uint8_t fr12_parse_mac(const char *s, uint8_t *mac);
+
+#endif /* FR12_PARSE_H */
@@ -0,0 +1,126 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#include "sched.h"
+#include "union_station.h"
+
+#include <avr/sleep.h>
+
+fr12_sched::fr12_sched(fr12_union_station *union_station) {
+  this->union_station = union_station;
+  memset(&this->tasks, 0x00, sizeof(this->tasks));
+  this->idles = 0;
+}
+
+fr12_sched::~fr12_sched() {
+
+}
+
+void fr12_sched::set(uint8_t id, fr12_sched_callback callback, uint8_t priority, uint32_t period, uint16_t budget) {
+  fr12_sched_task *task = &this->tasks[id];
+
+  memset(task, 0x00, sizeof(*task));
+  task->callback = callback;
+  task->priority = priority;
+  task->budget = budget;
+  this->set_period(id, period);
+}
+
+void fr12_sched::at(uint8_t id, uint32_t delay) {
+  fr12_sched_task *task = &this->tasks[id];
+
+  task->deadline = millis() + delay;
+  task->flags |= fr12_sched_active;
+}
+
+void fr12_sched::set_period(uint8_t id, uint32_t period) {
+  fr12_sched_task *task = &this->tasks[id];
+
+  if (period > (uint32_t)fr12_sched_period_max) {
+    period = fr12_sched_period_max;
+  }
+  task->period = period;
+  task->deadline = millis() + period;
+  if (period > 0) {
+    task->flags |= fr12_sched_active | fr12_sched_periodic;
+  }
+  else {
+    task->flags &= ~(fr12_sched_active | fr12_sched_periodic);
+  }
+}
+
+uint8_t fr12_sched::run() {
+  uint32_t now = millis();
+  uint8_t ran = 0;
+  fr12_sched_task *task;
+
+  // Everything that's due, most urgent first. Deadlines move past now as
+  // tasks run, so each runs at most once a pass.
+  while ((task = this->next(now)) != NULL) {
+    // Next deadline. A periodic task that fell a whole period behind skips
+    // ahead rather than running back to back to catch up.
+    if (task->flags & fr12_sched_periodic) {
+      task->deadline += task->period;
+      if ((int32_t)(now - task->deadline) >= 0) {
+        task->deadline = now + task->period;
+        task->misses++;
+      }
+    }
+    else {
+      task->flags &= ~fr12_sched_active;
+    }
+
+    // Run it against its budget
+    uint32_t start = micros();
+    ((this->union_station)->*(task->callback))();
+    uint32_t took = micros() - start;
+
+    task->runs++;
+    if (took > task->budget) {
+      task->overruns++;
+    }
+    if (took > task->worst) {
+      task->worst = took;
+    }
+    ran++;
+  }
+
+  return ran;
+}
+
+fr12_sched_task *fr12_sched::next(uint32_t now) {
+  fr12_sched_task *task = NULL;
+
+  // Lowest priority number, then most overdue
+  for (uint8_t a = 0; a < fr12_sched_tasks; a++) {
+    fr12_sched_task *t = &this->tasks[a];
+    if (!(t->flags & fr12_sched_active) || (int32_t)(now - t->deadline) < 0) {
+      continue;
+    }
+    if (task == NULL || t->priority < task->priority || (t->priority == task->priority && (int32_t)(t->deadline - task->deadline) < 0)) {
+      task = t;
+    }
+  }
+
+  return task;
+}
+
+void fr12_sched::idle() {
+  // The millisecond tick wakes us in time for the next deadline
+  this->idles++;
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_mode();
+}
+
+void fr12_sched::serialize(fr12_sched_status *status) {
+  status->idles = this->idles;
+  for (uint8_t a = 0; a < fr12_sched_tasks; a++) {
+    status->task[a].runs = this->tasks[a].runs;
+    status->task[a].overruns = this->tasks[a].overruns;
+    status->task[a].misses = this->tasks[a].misses;
+    status->task[a].worst = this->tasks[a].worst;
+  }
+}
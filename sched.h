@@ -0,0 +1,96 @@
+/*  _______ ______    ____   ______
+ * |    ___|   __ \  |_   | |__    |
+ * |    ___|      <   _|  |_|    __|
+ * |___|   |___|__|  |______|______|
+ */
+
+#ifndef FR12_SCHED_H
+#define FR12_SCHED_H
+
+#include "defs.h"
+
+// Task table size, and the longest period (ms). Deadlines are compared as
+// signed differences, so anything from 2^31 ms (about 24.8 days) on would
+// look overdue.
+enum {
+  fr12_sched_tasks = 8,
+  fr12_sched_period_max = 0x7fffffffL
+};
+
+// Task flags
+enum {
+  fr12_sched_active = (1 << 0),
+  fr12_sched_periodic = (1 << 1)
+};
+
+// FR 12 classes
+class fr12_sched;
+
+// Task callback
+typedef void (fr12_union_station::*fr12_sched_callback)();
+
+// One slot in the task table. Deadlines and periods are in milliseconds,
+// budgets and run times in microseconds.
+struct fr12_sched_task {
+  fr12_sched_callback callback;
+  uint32_t deadline, period;
+  uint16_t budget;
+  uint32_t worst;
+  uint8_t priority, flags;
+
+  // Runs, runs over budget, and periods skipped because the task was late
+  uint32_t runs;
+  uint16_t overruns, misses;
+};
+
+// Per-task counters, as served over HTTP
+struct fr12_sched_task_status {
+  uint32_t runs;
+  uint16_t overruns, misses;
+  uint32_t worst;
+}
+__attribute__ ((packed));
+
+struct fr12_sched_status {
+  uint32_t idles;
+  fr12_sched_task_status task[fr12_sched_tasks];
+}
+__attribute__ ((packed));
+
+class fr12_sched {
+public:
+  // Constructor
+  fr12_sched(fr12_union_station *union_station);
+
+  // Destructor
+  virtual ~fr12_sched();
+
+  // Puts a task in a slot. A period of 0 makes a one-shot that waits for
+  // at(); anything else repeats, first one period from now. Lower
+  // priorities go first when several tasks are due.
+  void set(uint8_t id, fr12_sched_callback callback, uint8_t priority, uint32_t period, uint16_t budget);
+
+  // Runs a task once after a delay, or restarts a periodic one's phase
+  void at(uint8_t id, uint32_t delay);
+
+  // Changes a periodic task's period, starting over from now. 0 stops it,
+  // and anything past fr12_sched_period_max is capped there.
+  void set_period(uint8_t id, uint32_t period);
+
+  // Runs every task that's due, most urgent first. Returns how many ran.
+  uint8_t run();
+
+  // Sleeps until the next interrupt
+  void idle();
+
+  // Counters
+  void serialize(fr12_sched_status *status);
+private:
+  fr12_sched_task *next(uint32_t now);
+
+  fr12_union_station *union_station;
+  fr12_sched_task tasks[fr12_sched_tasks];
+  uint32_t idles;
+};
+
+#endif /* FR12_SCHED_H */
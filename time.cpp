@@ -5,78 +5,203 @@
  */
 
 #include "time.h"
-#include "union_station.h"
 #include "config.h"
 
+fr12_time *fr12_time::running = NULL;
+
+ISR(TIMER1_COMPA_vect) {
+  fr12_time::interrupt();
+}
+
 fr12_time::fr12_time() {
   this->time_seconds = 0;
-  this->time_millis = this->prev_millis = 0;
-  this->sync_interval = this->next_sync = 0;
-  this->auto_sync = NULL;
-  this->union_station = NULL;
+  this->time_millis = 0;
+  this->sync_interval = 0;
+  this->second_length = 1000;
+  this->drift = this->drift_ns = 0;
+  this->drift_saved = 0;
+  this->drift_saved_at = 0;
+  this->slew = 0;
+  this->disciplined_at = 0;
+  this->prev_micros = this->micros_wraps = 0;
   this->flags = 0x00;
 }
 
 fr12_time::~fr12_time() {
-  
+  if (running == this) {
+    TIMSK1 &= ~_BV(OCIE1A);
+    running = NULL;
+  }
+}
+
+void fr12_time::begin() {
+  uint8_t sreg = SREG;
+  cli();
+  running = this;
+
+  // Timer1 in CTC mode, clocked at F_CPU / 64, matches once a millisecond
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);
+  OCR1A = F_CPU / 64 / 1000 - 1;
+  TIMSK1 |= _BV(OCIE1A);
+  SREG = sreg;
+}
+
+void fr12_time::interrupt() {
+  fr12_time *t = running;
+
+  // A soft reset jumps here before begin() runs again
+  if (t == NULL) {
+    return;
+  }
+
+  if (++t->time_millis >= t->second_length) {
+    t->time_millis = 0;
+    t->time_seconds++;
+    t->second_length = t->tick();
+  }
 }
 
 void fr12_time::set(uint32_t now) {
+  uint8_t sreg = SREG;
+  cli();
   this->time_seconds = now;
-  this->prev_millis = millis();
-  this->next_sync = this->time_seconds + this->sync_interval;
+  this->time_millis = 0;
+  this->slew = 0;
+  SREG = sreg;
 }
 
-void fr12_time::set_sync_interval(uint32_t sync_interval) {
-  this->sync_interval = sync_interval;
-  this->next_sync = this->time_seconds + this->sync_interval;
+void fr12_time::step(int64_t offset) {
+  // The whole seconds (rounded down) go straight on. What's left is a
+  // forward move of 0-999 ms.
+  uint16_t ms = ((offset & 0xffffffffULL) * 1000) >> 32;
+  uint8_t sreg = SREG;
+  cli();
+  this->time_seconds += (int32_t)(offset >> 32);
+  this->time_millis += ms;
+  if (this->time_millis >= this->second_length) {
+    this->time_millis -= this->second_length;
+    this->time_seconds++;
+  }
+  this->slew = 0;
+  SREG = sreg;
+}
+
+void fr12_time::stamp(uint32_t *seconds, uint32_t *fraction) {
+  uint16_t ms;
+  *seconds = this->now(&ms);
+  *fraction = ((uint64_t)ms << 32) / 1000;
+}
+
+uint8_t fr12_time::discipline(int64_t offset) {
+  int32_t whole = offset >> 32;
+  int32_t us = (whole == 0 || whole == -1) ? (int32_t)((offset * 1000000) >> 32) : 0;
+  uint32_t interval = this->now() - this->disciplined_at;
+  uint8_t events = 0, sreg;
+
+  // Big offsets step, and a second or more would overflow the microseconds.
+  // So does the first sync, which has no earlier one to measure drift
+  // against.
+  if ((whole != 0 && whole != -1) || us >= fr12_time_step_threshold * 1000L || us <= -fr12_time_step_threshold * 1000L || !(this->flags & fr12_time_disciplined)) {
+    this->step(offset);
+    this->flags |= fr12_time_disciplined;
+    this->disciplined_at = this->now();
+    return fr12_time_event_step;
+  }
+
+  // The timer spends drift and slew, so change them with it held off
+  sreg = SREG;
+  cli();
+
+  // Whatever built up since the last sync (less slew still owed from then)
+  // is the frequency error. Move the drift part of the way towards it.
+  if (interval >= fr12_time_fll_min_interval) {
+    int32_t ppb = (us - this->slew * 1000L) * 1000L / (int32_t)interval;
+    this->drift = constrain(this->drift + ppb / (1 << fr12_time_fll_gain), -fr12_time_drift_max, fr12_time_drift_max);
+  }
+
+  // The offset itself is slewed out, replacing whatever was left
+  this->slew = us / 1000;
+  SREG = sreg;
+
+  // Every save wears the EEPROM, so only a real move counts
+  this->disciplined_at = this->now();
+  if (labs(this->drift - this->drift_saved) > fr12_time_drift_save_threshold && this->disciplined_at - this->drift_saved_at >= fr12_time_drift_save_interval) {
+    this->drift_saved = this->drift;
+    this->drift_saved_at = this->disciplined_at;
+    events |= fr12_time_event_drift;
+  }
+
+  return events;
 }
 
-void fr12_time::set_auto_sync(fr12_union_station *union_station, fr12_time_callback callback) {
-  this->auto_sync = callback;
-  this->union_station = union_station;
-  this->flags |= fr12_time_auto_sync;
+uint16_t fr12_time::tick() {
+  uint16_t length = 1000;
+
+  // A positive drift means the crystal runs slow, so seconds get shorter.
+  // It builds up in nanoseconds until it's worth a millisecond.
+  this->drift_ns += this->drift;
+  if (this->drift_ns >= 1000000L) {
+    this->drift_ns -= 1000000L;
+    length--;
+  }
+  else if (this->drift_ns <= -1000000L) {
+    this->drift_ns += 1000000L;
+    length++;
+  }
+
+  // Slew up to a millisecond a second
+  if (this->slew > 0) {
+    this->slew--;
+    length--;
+  }
+  else if (this->slew < 0) {
+    this->slew++;
+    length++;
+  }
+
+  return length;
 }
 
-void fr12_time::set_auto_sync(fr12_union_station *union_station, fr12_time_callback callback, uint32_t interval) {
-  this->set_auto_sync(union_station, callback);
-  this->set_sync_interval(interval);
+void fr12_time::set_sync_interval(uint32_t sync_interval) {
+  this->sync_interval = sync_interval;
 }
 
 void fr12_time::update() {
-  // Find the current time in seconds and milliseconds
-  while (millis() - this->prev_millis >= 1000) {
-    this->time_seconds++;
-    this->prev_millis += 1000;
-  }
-  this->time_millis = millis() % this->prev_millis;
-  
-  // Determine if we need to sync
-  if (this->sync_interval > 0 && this->time_seconds >= this->next_sync && !(this->flags & fr12_time_should_sync)) {
-    this->flags |= fr12_time_should_sync;
-    
-    // If auto sync is enabled, do so
-    if (this->flags & fr12_time_auto_sync && this->union_station != NULL && this->auto_sync != 0) {
-      // Sync
-      ((this->union_station)->*(this->auto_sync))();
-      
-      // Set the next sync time
-      this->next_sync = this->time_seconds + this->sync_interval;
-      
-      // Clear sync flag
-      this->flags &= ~fr12_time_should_sync;
-    }
+  this->uptime_us();
+}
+
+uint64_t fr12_time::uptime_us() {
+  uint32_t us = micros();
+  if (us < this->prev_micros) {
+    this->micros_wraps++;
   }
+  this->prev_micros = us;
+  return (uint64_t)this->micros_wraps << 32 | us;
 }
 
 uint32_t fr12_time::now() {
-  return this->time_seconds;
+  uint16_t ms;
+  return this->now(&ms);
+}
+
+uint32_t fr12_time::now(uint16_t *millis) {
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t seconds = this->time_seconds;
+  *millis = this->time_millis;
+  SREG = sreg;
+  return seconds;
 }
 
 uint32_t fr12_time::get_sync_interval() {
   return this->sync_interval;
 }
 
+int32_t fr12_time::get_drift() {
+  return this->drift;
+}
+
 uint8_t fr12_time::get_flags() {
   return this->flags;
 }
@@ -84,9 +209,16 @@ uint8_t fr12_time::get_flags() {
 void fr12_time::configure(fr12_time_serialized *ee) {
   this->set_sync_interval(ee->sync_interval);
   this->set(ee->seconds);
+
+  uint8_t sreg = SREG;
+  cli();
+  this->drift = constrain(ee->drift, -fr12_time_drift_max, fr12_time_drift_max);
+  SREG = sreg;
+  this->drift_saved = this->drift;
 }
 
 void fr12_time::serialize(fr12_time_serialized *ee) {
-  ee->seconds = this->time_seconds;
+  ee->seconds = this->now();
   ee->sync_interval = this->sync_interval;
+  ee->drift = this->drift;
 }
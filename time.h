@@ -11,13 +11,41 @@
 
 // Defaults
 enum {
-  fr12_time_default = 946684800UL // Y2K
+  fr12_time_default = 946684800UL, // Y2K
+  fr12_time_default_sync_interval = 3600
+};
+
+// Discipline
+enum {
+  // Offsets this big (ms) or bigger are stepped; smaller ones are slewed a
+  // millisecond a second
+  fr12_time_step_threshold = 128,
+  
+  // Syncs closer together than this (s) don't update the frequency
+  fr12_time_fll_min_interval = 60,
+  
+  // Each frequency estimate moves the drift 1/2^gain of the way there
+  fr12_time_fll_gain = 2,
+  
+  // Drift limit (ppb)
+  fr12_time_drift_max = 500000L,
+  
+  // The drift is only worth saving again once it has moved this far (ppb)
+  // from what was saved, and no more often than this (s). Millisecond
+  // offsets over a minute-long interval wobble each estimate by ~15 ppm.
+  fr12_time_drift_save_threshold = 10000,
+  fr12_time_drift_save_interval = 3600
+};
+
+// What discipline() did
+enum {
+  fr12_time_event_drift = (1 << 0),
+  fr12_time_event_step = (1 << 1)
 };
 
 // Flags
 enum {
-  fr12_time_should_sync = (1 << 0),
-  fr12_time_auto_sync = (1 << 1)
+  fr12_time_disciplined = (1 << 0)
 };
 
 // FR 12 classes
@@ -28,56 +56,85 @@ class fr12_config;
 // Serialization structs
 struct fr12_time_serialized;
 
-// Time callback handler
-typedef void (fr12_union_station::*fr12_time_callback)();
-
 class fr12_time {
 public:
-  friend class fr12_countdown;
-  
   // Constructor
   fr12_time();
   
   // Destructor
   virtual ~fr12_time();
   
+  // Starts the millisecond tick
+  void begin();
+  
+  // Advances the clock a millisecond (TIMER1_COMPA)
+  static void interrupt();
+  
   // Sets current time
   void set(uint32_t now);
   
-  // Enables auto sync and changes sync interval
-  void set_auto_sync(fr12_union_station *union_station, fr12_time_callback callback);
-  void set_auto_sync(fr12_union_station *union_station, fr12_time_callback callback, uint32_t interval);
+  // Moves the clock by a 32.32 fixed-point number of seconds, millisecond
+  // phase included
+  void step(int64_t offset);
+  
+  // Current time as seconds and a 32-bit binary fraction
+  void stamp(uint32_t *seconds, uint32_t *fraction);
+  
+  // Corrects the clock by a measured 32.32 offset: steps or slews it, and
+  // learns the drift. Returns fr12_time_event_step if it stepped, and
+  // fr12_time_event_drift if the drift has moved far enough from the last
+  // one configured or reported to be worth saving.
+  uint8_t discipline(int64_t offset);
+  
+  // Changes the sync interval. The scheduler runs the syncs.
   void set_sync_interval(uint32_t sync_interval);
   
-  // Updates the clock
+  // Keeps uptime_us() counting. The clock itself runs off the timer.
   void update();
   
-  // Getters
+  // Microseconds since boot, for profiling. Carries micros() past its
+  // 71-minute wrap as long as something calls it that often; update() does.
+  uint64_t uptime_us();
+  
+  // Current time, and the same with the milliseconds into the second, read
+  // in one go
   uint32_t now();
+  uint32_t now(uint16_t *millis);
+  
+  // Getters
   uint32_t get_sync_interval();
+  int32_t get_drift();
   uint8_t get_flags();
   
   // Configuration
   void configure(fr12_time_serialized *ee);
   void serialize(fr12_time_serialized *ee);
 private:
-  // Autosync function pointer
-  fr12_time_callback auto_sync;
+  // The clock the timer drives
+  static fr12_time *running;
+  
+  // Sync interval
+  uint32_t sync_interval;
+  
+  // How many milliseconds the current second lasts
+  volatile uint16_t second_length;
   
-  // Pointer to Union Station
-  fr12_union_station *union_station;
+  // Drift (ppb, or ns per second) and its sub-millisecond build-up,
+  // milliseconds still to slew, and when the last sync was
+  volatile int32_t drift, drift_ns;
+  int32_t drift_saved;
+  uint32_t drift_saved_at;
+  volatile int16_t slew;
+  uint32_t disciplined_at;
   
-  // Sync interval and next sync
-  uint32_t sync_interval, next_sync;
+  // Previous micros() count and how many times it has wrapped
+  uint32_t prev_micros, micros_wraps;
   
-  // Previous millis() count
-  uint32_t prev_millis;
-protected:
-  // Current time (seconds)
-  uint32_t time_seconds;
+  uint16_t tick();
   
-  // Current time (left over milliseconds)
-  uint16_t time_millis;
+  // Current time (seconds), and milliseconds into it
+  volatile uint32_t time_seconds;
+  volatile uint16_t time_millis;
   
   // Flags
   uint8_t flags;
@@ -11,9 +11,12 @@
 #include "glcd.h"
 #include "minecraft.h"
 #include "net.h"
+#include "http.h"
 #include "ntp.h"
 #include "time.h"
 #include "countdown.h"
+#include "events.h"
+#include "sched.h"
 
 fr12_union_station::fr12_union_station() {
   this->config = new fr12_config(this);
@@ -23,11 +26,21 @@ fr12_union_station::fr12_union_station() {
   this->ntp = new fr12_ntp();
   this->time = new fr12_time();
   this->countdown = NULL;
-  this->sync_index = 1;
+  this->events = new fr12_events();
+  this->sched = new fr12_sched(this);
+  this->tick_seconds = 0;
+  this->boot_flags = 0;
+  this->boot_address = 0;
+  this->display_first = this->display_colon = 0;
+  memset(&this->event, 0x00, sizeof(this->event));
+  this->complete_since = 0;
+  FR12_CORO_INIT(&this->boot);
   this->flags = 0;
 }
 
 fr12_union_station::~fr12_union_station() {
+  delete this->sched;
+  delete this->events;
   delete this->countdown;
   delete this->time;
   delete this->ntp;
@@ -48,6 +61,9 @@ void fr12_union_station::setup() {
   // Start up the GLCD
   this->glcd->begin();
 
+  // Start the clock ticking
+  this->time->begin();
+
   // Welcome message
   this->glcd->hw->Puts_P(PSTR("Froshduino " FR12_VERSION));
   this->glcd->hw->Puts_P(PSTR("\n(C) Morgan Jones 2012"));
@@ -65,160 +81,104 @@ void fr12_union_station::setup() {
   this->glcd->status->Puts_P(PSTR("Loading configuration."));
   this->config->begin();
 
-  // Start up networking
-  uint8_t *mac = this->net->get_mac();
-  this->glcd->status->ClearArea();
-  this->glcd->status->Puts_P(PSTR("MAC: "));
-  this->glcd->status->Printf_P(PSTR("%.2x:%.2x:%.2x:%.2x:%.2x:%.2x"), mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  delay(1500);
-
-  // Initial setup of networking
+  // Start up networking. A fast boot comes up on its cached lease or the
+  // static address and starts HTTP and the countdown now; a slow one shows
+  // each step on the splash screen first. The rest of either runs in
+  // do_boot(), between the other tasks.
   this->net->begin(this);
-
-  // Decide how to get an IP
-  int ret = 0;
-  this->glcd->status->ClearArea();
-  if (this->net->get_flags() & fr12_net_use_dhcp) {
-    this->glcd->status->Puts_P(PSTR("DHCP..."));
-    ret = this->net->begin_ethernet_dhcp();
-  }
-
-  if (!(this->net->get_flags() & fr12_net_use_dhcp) || ret == 0) {
-    this->glcd->status->ClearArea();
-    this->glcd->status->Puts_P(PSTR("Using static IP."));
-    delay(1500);
-    this->net->begin_ethernet_static();
-  }
-
-  // Print IP/DNS/gateway/subnet
-  IPAddress addresses[4];
-  this->net->get_addresses((IPAddress *)&addresses);
-
-  for (uint8_t a = 0; a < 4; a++) {
-    this->glcd->status->ClearArea();
-    switch(a) {
-    case 0:
-      this->glcd->status->Puts_P(PSTR("IP"));
-      break;
-    case 1:
-      this->glcd->status->Puts_P(PSTR("DNS"));
-      break;
-    case 2:
-      this->glcd->status->Puts_P(PSTR("Gateway"));
-      break;
-    case 3:
-      this->glcd->status->Puts_P(PSTR("Subnet"));
-      break;
-    default:
-      continue;
-      break;
+  this->flags |= fr12_union_station_booting;
+  if (this->boot_flags & fr12_union_station_boot_fast) {
+    if (!this->net->begin_ethernet_lease(this->time->now())) {
+      this->net->begin_ethernet_static();
+      if (this->net->get_flags() & fr12_net_use_dhcp) {
+        this->flags |= fr12_union_station_dhcp_pending;
+      }
     }
-    this->glcd->status->Puts_P(PSTR(": "));
-    this->glcd->status->Printf_P(PSTR("%u.%u.%u.%u"), addresses[a][0], addresses[a][1], addresses[a][2], addresses[a][3]);
-    delay(1500);
+    this->net->begin_http(&fr12_union_station::http_handler);
+    this->do_redraw_screen();
   }
-
-  // Set up NTP
-  this->glcd->status->ClearArea();
-  this->glcd->status->Puts_P(PSTR("Syncing local clock..."));
-  this->ntp->begin(addresses[1]);
-  this->do_sync_ntp();
-  delay(1500);
-  this->glcd->status->ClearArea();
-  this->glcd->status->Printf_P(PSTR("Interval: %lus"), this->time->get_sync_interval());
-  delay(1500);
-
-  // Set up automatic clock synchronization
-  this->time->set_auto_sync(this, &fr12_union_station::sync_handler);
-
-  // Start HTTP
-  this->glcd->status->ClearArea();
-  this->net->begin_http(&fr12_union_station::http_handler);
-
-  // Switch to the main loop. Clear the screen and all areas.
-  this->do_redraw_screen();
+  else {
+    this->flags |= fr12_union_station_splash;
+  }
+  this->do_schedule();
 }
 
 void fr12_union_station::loop() {
-  // Update time
-  this->time->update();
-  
-  // Process HTTP connections
-  this->net->handle_http();
-
-  // Target not yet reached
-  if (!this->countdown->target_reached()) {
-    // Update countdown
-    this->countdown->update(this->time);
-
-    // The countdown just finished. Update the message.
-    if (this->countdown->target_reached() && !(this->flags & fr12_union_station_complete)) {
-      // We're done!
-      this->flags |= fr12_union_station_complete;
-      
-      // Make a LCD message
-      fr12_lcd_message message;
-      strncpy((char *)&message.text, "FR 2012\nHoist the sails", sizeof(message.text));
-      
-      // Make it red
-      message.r = 255;
-      message.g = message.b = 0;
-      
-      // Totally redraw the screen
-      this->do_redraw_screen();
-      
-      // Zero out the countdown
-      this->glcd->countdown->Puts_P(PSTR(" 00:00:00:00.00"));
-      
-      // Set the message on the text LCD
-      this->lcd->set_message(&message);
-    }
-    
-    // Otherwise, update the countdown
-    else if (!this->countdown->target_reached()){
-      // Start at the beginning of the string
-      this->glcd->countdown->CursorToXY(0, 0);
-      this->glcd->countdown->write(' ');
-
-      // Display results based upon colon
-      if (this->flags & fr12_union_station_colon) {
-        this->glcd->countdown->Printf_P(PSTR("%.2u:%.2u:%.2u:%.2u.%.2u"), this->countdown->days, this->countdown->hours, this->countdown->mins, this->countdown->secs, this->countdown->millis / 10);
-      } 
-      else {
-        this->glcd->countdown->Printf_P(PSTR("%.2u %.2u %.2u %.2u %.2u"), this->countdown->days, this->countdown->hours, this->countdown->mins, this->countdown->secs, this->countdown->millis / 10);
-      }
-    }
+  // Run whatever's due, or sleep until something might be
+  if (!this->sched->run()) {
+    this->sched->idle();
   }
 }
 
 void fr12_union_station::configure(fr12_union_station_serialized *ee) {
-  delete this->countdown;
-  this->countdown = new fr12_countdown(ee->countdown_to);
+  this->boot_flags = ee->boot_flags;
 }
 
 void fr12_union_station::serialize(fr12_union_station_serialized *ee) {
-  ee->countdown_to = this->countdown->get_timestamp();
+  ee->reserved = 0;
+  ee->boot_flags = this->boot_flags;
 }
 
 void fr12_union_station::sync_handler() {
-  // Serialize the current time and write it to EEPROM if we need to as well
-  if (this->sync_index % fr12_union_station_config_write_interval == 0) {
-    fr12_time_serialized t;
-    this->time->serialize(&t);
-    this->config->write_time(&t);
+  // Resync every sync interval (fr12_ntp keeps rounds at least a minute
+  // apart). Boot starts its own first round.
+  if (!(this->flags & fr12_union_station_booting)) {
+    this->ntp->sync();
   }
-  
-  // Toggle the heartbeat LED
-  PORTB ^= _BV(PB7);
+}
 
-  // Toggle the colon
-  this->flags ^= fr12_union_station_colon;
+template <> fr12_union_station *fr12_union_station::http_module<fr12_union_station>() {
+  return this;
+}
+
+template <> fr12_lcd *fr12_union_station::http_module<fr12_lcd>() {
+  return this->lcd;
+}
+
+template <> fr12_net *fr12_union_station::http_module<fr12_net>() {
+  return this->net;
+}
+
+template <> fr12_ntp *fr12_union_station::http_module<fr12_ntp>() {
+  return this->ntp;
+}
 
-  // Increment sync index
-  this->sync_index++;
+template <> fr12_time *fr12_union_station::http_module<fr12_time>() {
+  return this->time;
 }
 
-void fr12_union_station::http_handler(EthernetClient *client, char *path) {
+const fr12_union_station_route fr12_union_station::http_routes[] = {
+  { "countdown", &fr12_union_station::http_route<fr12_union_station, fr12_union_station_serialized, &fr12_union_station::http_get_countdown, &fr12_union_station::http_set_countdown, &fr12_config::write_union_station> },
+  { "lcd", &fr12_union_station::http_route<fr12_lcd, fr12_lcd_serialized, &fr12_union_station::http_get_lcd, &fr12_union_station::http_set_lcd, &fr12_config::write_lcd> },
+  { "net", &fr12_union_station::http_route<fr12_net, fr12_net_serialized, &fr12_union_station::http_get_net, &fr12_union_station::http_set_net, &fr12_config::write_net> },
+  { "ntp", &fr12_union_station::http_route<fr12_ntp, fr12_ntp_serialized, &fr12_union_station::http_get_ntp, &fr12_union_station::http_set_ntp, &fr12_config::write_ntp> },
+  { "time", &fr12_union_station::http_route<fr12_time, fr12_time_serialized, &fr12_union_station::http_get_time, &fr12_union_station::http_set_time, &fr12_config::write_time> },
+  { "sched", &fr12_union_station::http_route_sched },
+  { "events", &fr12_union_station::http_route_events }
+};
+
+// What the splash screen calls each of fr12_net's addresses
+static const char fr12_union_station_address_names[][8] PROGMEM = {
+  "IP", "DNS", "Gateway", "Subnet"
+};
+
+// Scheduler tasks, in slot order. The sync task's period comes from the
+// clock's sync interval.
+const fr12_union_station_task fr12_union_station::tasks[] = {
+  { &fr12_union_station::do_display, 40, 8000 },
+  { &fr12_union_station::do_tick, 10, 200 },
+  { &fr12_union_station::do_ntp_step, 1, 2000 },
+  { &fr12_union_station::do_http, 2, 4000 },
+  { &fr12_union_station::do_net, 100, 2000 },
+  { &fr12_union_station::do_boot, 10, 2000 },
+  { &fr12_union_station::do_journal, fr12_union_station_config_write_interval, 1000 },
+  { &fr12_union_station::sync_handler, 0, 500 }
+};
+
+void fr12_union_station::http_handler(EthernetClient *client, fr12_http_request *request) {
+  char *path = request->path, *module;
+  uint8_t verb;
+
   // Malformed URL, so 400
   if (path[0] != '/') {
     this->net->http_respond(client, 400); 
@@ -226,235 +186,413 @@ void fr12_union_station::http_handler(EthernetClient *client, char *path) {
   }
   
   // Root isn't accessible. Make it forbidden.
-  else if (strcmp_P(path, PSTR("/")) == 0) {
+  else if (path[1] == '\0') {
     this->net->http_respond(client, 403);
     return;
   }
   
-  // Tokenize
-  path = strtok(path, "/");
-
-  // Tokenize
-  if (path != NULL) {
-    if (strcasecmp_P(path, PSTR("get")) == 0) {
-      if ((path = strtok(NULL, "/")) != NULL) {
-        if (strcasecmp_P(path, PSTR("countdown")) == 0) {
-          this->http_get<fr12_union_station, fr12_union_station_serialized>(&fr12_union_station::http_get_countdown, this, client);
-          return;
-        }
-        else if (strcasecmp_P(path, PSTR("lcd")) == 0) {
-          this->http_get<fr12_lcd, fr12_lcd_serialized>(&fr12_union_station::http_get_lcd, this->lcd, client);
-          return;
-        } 
-        else if (strcasecmp_P(path, PSTR("net")) == 0) {
-          this->http_get<fr12_net, fr12_net_serialized>(&fr12_union_station::http_get_net, this->net, client);
-          return;
-        } 
-        else if (strcasecmp_P(path, PSTR("ntp")) == 0) {
-          this->http_get<fr12_ntp, fr12_ntp_serialized>(&fr12_union_station::http_get_ntp, this->ntp, client);
-          return;
-        } 
-        else if (strcasecmp_P(path, PSTR("time")) == 0) {
-          this->http_get<fr12_time, fr12_time_serialized>(&fr12_union_station::http_get_time, this->time, client);
-          return;
-        }
-      }
-    } 
-    else if (strcasecmp_P(path, PSTR("set")) == 0) {
-      if ((path = strtok(NULL, "/?")) != NULL) {
-        if (strcasecmp_P(path, PSTR("countdown")) == 0) {
-          this->http_set<fr12_union_station, fr12_union_station_serialized>(&fr12_union_station::http_set_countdown, &fr12_config::write_union_station, this, path);
-          this->http_get<fr12_union_station, fr12_union_station_serialized>(&fr12_union_station::http_get_countdown, this, client);
-          return;
-        }
-        else if (strcasecmp_P(path, PSTR("lcd")) == 0) {
-          this->http_set<fr12_lcd, fr12_lcd_serialized>(&fr12_union_station::http_set_lcd, &fr12_config::write_lcd, this->lcd, path);
-          this->http_get<fr12_lcd, fr12_lcd_serialized>(&fr12_union_station::http_get_lcd, this->lcd, client);
-          return;
-        }
-        else if (strcasecmp_P(path, PSTR("net")) == 0) {
-          this->http_set<fr12_net, fr12_net_serialized>(&fr12_union_station::http_set_net, &fr12_config::write_net, this->net, path);
-          this->http_get<fr12_net, fr12_net_serialized>(&fr12_union_station::http_get_net, this->net, client);
-          return;
-        }
-        else if (strcasecmp_P(path, PSTR("ntp")) == 0) {
-          this->http_set<fr12_ntp, fr12_ntp_serialized>(&fr12_union_station::http_set_ntp, &fr12_config::write_ntp, this->ntp, path);
-          this->http_get<fr12_ntp, fr12_ntp_serialized>(&fr12_union_station::http_get_ntp, this->ntp, client);
-          return;
-        }
-        else if (strcasecmp_P(path, PSTR("time")) == 0) {
-          this->http_set<fr12_time, fr12_time_serialized>(&fr12_union_station::http_set_time, &fr12_config::write_time, this->time, path);
-          this->http_get<fr12_time, fr12_time_serialized>(&fr12_union_station::http_get_time, this->time, client);
-          return;
-        }
-      }
-    } else if (strcasecmp_P(path, PSTR("reset")) == 0) {
-      this->config->reset();
-      this->net->http_respond(client, 200);
-      __asm__ __volatile__ ("jmp 0x00");
+  // Split "/<verb>/<module>", ignoring anything after the module
+  path++;
+  module = this->do_split(path, '/');
+  this->do_split(module, '/');
+
+  if (strcasecmp_P(path, PSTR("get")) == 0) {
+    verb = fr12_union_station_verb_get;
+  }
+  else if (strcasecmp_P(path, PSTR("set")) == 0) {
+    verb = fr12_union_station_verb_set;
+  }
+  else if (strcasecmp_P(path, PSTR("reset")) == 0) {
+    this->config->reset();
+    this->config->flush();
+    this->net->http_respond(client, 200);
+    FR12_SOFT_RESET();
+    return;
+  }
+  else {
+    this->net->http_respond(client, 404);
+    return;
+  }
+
+  // Look the module up: a linear scan over the rows, where a first letter
+  // that differs skips the flash string compare. Only rows sharing the
+  // module's first letter get compared (net and ntp do), so adding rows
+  // adds compares.
+  for (uint8_t a = 0; a < sizeof(http_routes) / sizeof(http_routes[0]); a++) {
+    const fr12_union_station_route *r = &http_routes[a];
+    if ((pgm_read_byte(&r->name[0]) | 0x20) != (module[0] | 0x20) || strcasecmp_P(module, r->name) != 0) {
+      continue;
     }
+
+    // Member function pointers are wider than a word, so copy the row's out
+    fr12_union_station_http_route_callback route;
+    memcpy_P(&route, &r->route, sizeof(route));
+    ((this)->*(route))(verb, client, request->query);
+    return;
   }
   
   // Respond 404 otherwise.
   this->net->http_respond(client, 404);
 }
 
+// JSON schemas. Names match the keys the setters take.
+static const fr12_http_json_field fr12_union_station_json_countdown[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("boot_flags", fr12_http_json_uint, fr12_union_station_serialized, boot_flags)
+};
+
+static const fr12_http_json_field fr12_union_station_json_event[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("time", fr12_http_json_uint, fr12_event, timestamp),
+  FR12_HTTP_JSON_FIELD("name", fr12_http_json_string, fr12_event, name)
+};
+
+static const fr12_http_json_field fr12_union_station_json_countdown_left[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("days", fr12_http_json_uint, fr12_countdown_serialized, days),
+  FR12_HTTP_JSON_FIELD("hours", fr12_http_json_uint, fr12_countdown_serialized, hours),
+  FR12_HTTP_JSON_FIELD("mins", fr12_http_json_uint, fr12_countdown_serialized, mins),
+  FR12_HTTP_JSON_FIELD("secs", fr12_http_json_uint, fr12_countdown_serialized, secs),
+  FR12_HTTP_JSON_FIELD("millis", fr12_http_json_uint, fr12_countdown_serialized, millis)
+};
+
+#define FR12_UNION_STATION_JSON_EVENT(n) \
+  FR12_HTTP_JSON_FIELD("event" #n "_time", fr12_http_json_uint, fr12_events_serialized, event[n].timestamp), \
+  FR12_HTTP_JSON_FIELD("event" #n "_name", fr12_http_json_string, fr12_events_serialized, event[n].name)
+
+// Only the first count targets are sent
+static const fr12_http_json_field fr12_union_station_json_events[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("count", fr12_http_json_uint, fr12_events_serialized, count),
+  FR12_UNION_STATION_JSON_EVENT(0),
+  FR12_UNION_STATION_JSON_EVENT(1),
+  FR12_UNION_STATION_JSON_EVENT(2),
+  FR12_UNION_STATION_JSON_EVENT(3),
+  FR12_UNION_STATION_JSON_EVENT(4),
+  FR12_UNION_STATION_JSON_EVENT(5),
+  FR12_UNION_STATION_JSON_EVENT(6),
+  FR12_UNION_STATION_JSON_EVENT(7)
+};
+
+static const fr12_http_json_field fr12_union_station_json_lcd[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("r", fr12_http_json_uint, fr12_lcd_serialized, msg.r),
+  FR12_HTTP_JSON_FIELD("g", fr12_http_json_uint, fr12_lcd_serialized, msg.g),
+  FR12_HTTP_JSON_FIELD("b", fr12_http_json_uint, fr12_lcd_serialized, msg.b),
+  FR12_HTTP_JSON_FIELD("msg", fr12_http_json_string, fr12_lcd_serialized, msg.text)
+};
+
+static const fr12_http_json_field fr12_union_station_json_net[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("flags", fr12_http_json_uint, fr12_net_serialized, flags),
+  FR12_HTTP_JSON_FIELD("mac", fr12_http_json_mac, fr12_net_serialized, mac),
+  FR12_HTTP_JSON_FIELD("ip", fr12_http_json_ipv4, fr12_net_serialized, ip),
+  FR12_HTTP_JSON_FIELD("dns", fr12_http_json_ipv4, fr12_net_serialized, dns),
+  FR12_HTTP_JSON_FIELD("gateway", fr12_http_json_ipv4, fr12_net_serialized, gateway),
+  FR12_HTTP_JSON_FIELD("subnet", fr12_http_json_ipv4, fr12_net_serialized, subnet)
+};
+
+static const fr12_http_json_field fr12_union_station_json_net_status[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("lease", fr12_http_json_uint, fr12_net_status, lease),
+  FR12_HTTP_JSON_FIELD("lease_expires", fr12_http_json_uint, fr12_net_status, lease_expires),
+  FR12_HTTP_JSON_FIELD("address", fr12_http_json_ipv4, fr12_net_status, address),
+  FR12_HTTP_JSON_FIELD("relinks", fr12_http_json_uint, fr12_net_status, relinks)
+};
+
+static const fr12_http_json_field fr12_union_station_json_ntp[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("server", fr12_http_json_string, fr12_ntp_serialized, server[0]),
+  FR12_HTTP_JSON_FIELD("server1", fr12_http_json_string, fr12_ntp_serialized, server[1]),
+  FR12_HTTP_JSON_FIELD("server2", fr12_http_json_string, fr12_ntp_serialized, server[2]),
+  FR12_HTTP_JSON_FIELD("server3", fr12_http_json_string, fr12_ntp_serialized, server[3])
+};
+
+#define FR12_UNION_STATION_JSON_PEER(n) \
+  FR12_HTTP_JSON_FIELD("peer" #n "_ip", fr12_http_json_ipv4, fr12_ntp_status, peer[n].address), \
+  FR12_HTTP_JSON_FIELD("peer" #n "_reach", fr12_http_json_uint, fr12_ntp_status, peer[n].reach), \
+  FR12_HTTP_JSON_FIELD("peer" #n "_offset", fr12_http_json_int, fr12_ntp_status, peer[n].offset), \
+  FR12_HTTP_JSON_FIELD("peer" #n "_delay", fr12_http_json_int, fr12_ntp_status, peer[n].delay)
+
+static const fr12_http_json_field fr12_union_station_json_ntp_status[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("selected", fr12_http_json_uint, fr12_ntp_status, selected),
+  FR12_HTTP_JSON_FIELD("survivors", fr12_http_json_uint, fr12_ntp_status, survivors),
+  FR12_UNION_STATION_JSON_PEER(0),
+  FR12_UNION_STATION_JSON_PEER(1),
+  FR12_UNION_STATION_JSON_PEER(2),
+  FR12_UNION_STATION_JSON_PEER(3)
+};
+
+static const fr12_http_json_field fr12_union_station_json_time[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("time", fr12_http_json_uint, fr12_time_serialized, seconds),
+  FR12_HTTP_JSON_FIELD("sync_interval", fr12_http_json_uint, fr12_time_serialized, sync_interval),
+  FR12_HTTP_JSON_FIELD("drift", fr12_http_json_int, fr12_time_serialized, drift)
+};
+
+#define FR12_UNION_STATION_JSON_TASK(name, n) \
+  FR12_HTTP_JSON_FIELD(name "_runs", fr12_http_json_uint, fr12_sched_status, task[n].runs), \
+  FR12_HTTP_JSON_FIELD(name "_over", fr12_http_json_uint, fr12_sched_status, task[n].overruns), \
+  FR12_HTTP_JSON_FIELD(name "_miss", fr12_http_json_uint, fr12_sched_status, task[n].misses), \
+  FR12_HTTP_JSON_FIELD(name "_worst", fr12_http_json_uint, fr12_sched_status, task[n].worst)
+
+static const fr12_http_json_field fr12_union_station_json_sched[] PROGMEM = {
+  FR12_HTTP_JSON_FIELD("idles", fr12_http_json_uint, fr12_sched_status, idles),
+  FR12_UNION_STATION_JSON_TASK("display", fr12_union_station_task_display),
+  FR12_UNION_STATION_JSON_TASK("tick", fr12_union_station_task_tick),
+  FR12_UNION_STATION_JSON_TASK("ntp", fr12_union_station_task_ntp),
+  FR12_UNION_STATION_JSON_TASK("http", fr12_union_station_task_http),
+  FR12_UNION_STATION_JSON_TASK("net", fr12_union_station_task_net),
+  FR12_UNION_STATION_JSON_TASK("boot", fr12_union_station_task_boot),
+  FR12_UNION_STATION_JSON_TASK("journal", fr12_union_station_task_journal),
+  FR12_UNION_STATION_JSON_TASK("sync", fr12_union_station_task_sync)
+};
+
+#define FR12_UNION_STATION_JSON(schema, data) { schema, sizeof(schema) / sizeof(schema[0]), data }
+
 void fr12_union_station::http_get_countdown(void *ee, EthernetClient *client) {
-  fr12_union_station_serialized *us = (fr12_union_station_serialized *)ee;
-  char countdown_to[11], countdown_time[32];
-  char *arr[] = {
-    (char *)&countdown_to,
-    (char *)&countdown_time
+  fr12_countdown_serialized left;
+  this->countdown->serialize(&left);
+
+  fr12_http_json_object objects[] = {
+    FR12_UNION_STATION_JSON(fr12_union_station_json_countdown, ee),
+    FR12_UNION_STATION_JSON(fr12_union_station_json_event, &this->event),
+    FR12_UNION_STATION_JSON(fr12_union_station_json_countdown_left, &left)
   };
-  snprintf_P((char *)&countdown_to, sizeof(countdown_to), PSTR("%lu"), us->countdown_to);
-  snprintf_P((char *)&countdown_time, sizeof(countdown_time), PSTR("%.2u:%.2u:%.2u:%.2u.%.4u"), this->countdown->days, this->countdown->hours, this->countdown->mins, this->countdown->secs, this->countdown->millis);
-  this->net->http_respond_json(client, 200, (const char **)arr, 2);
+  this->net->http_respond_json(client, 200, objects, 3);
 }
 
 void fr12_union_station::http_get_lcd(void *ee, EthernetClient *client) {
-  fr12_lcd_serialized *lcd = (fr12_lcd_serialized *)ee;
-  char lcd_r_str[4], lcd_g_str[4], lcd_b_str[4];
-  char *arr[] = {
-    (char *)&lcd_r_str,
-    (char *)&lcd_g_str,
-    (char *)&lcd_b_str,
-    (char *)&lcd->msg.text
-  };
+  fr12_http_json_object object = FR12_UNION_STATION_JSON(fr12_union_station_json_lcd, ee);
+  this->net->http_respond_json(client, 200, &object, 1);
+}
 
-  snprintf_P((char *)&lcd_r_str, sizeof(lcd_r_str), PSTR("%u"), lcd->msg.r);
-  snprintf_P((char *)&lcd_g_str, sizeof(lcd_g_str), PSTR("%u"), lcd->msg.g);
-  snprintf_P((char *)&lcd_b_str, sizeof(lcd_b_str), PSTR("%u"), lcd->msg.b);
+void fr12_union_station::http_get_net(void *ee, EthernetClient *client) {
+  fr12_net_status status;
+  this->net->serialize_status(&status);
 
-  this->net->http_respond_json(client, 200, (const char **)arr, 4);
+  fr12_http_json_object objects[] = {
+    FR12_UNION_STATION_JSON(fr12_union_station_json_net, ee),
+    FR12_UNION_STATION_JSON(fr12_union_station_json_net_status, &status)
+  };
+  this->net->http_respond_json(client, 200, objects, 2);
 }
 
-void fr12_union_station::http_get_net(void *ee, EthernetClient *client) {
-  fr12_net_serialized *network = (fr12_net_serialized *)ee;
-  IPAddress ip(network->ip), dns(network->dns), gateway(network->gateway), subnet(network->subnet);
-  char ip_str[16], dns_str[16], gateway_str[16], subnet_str[16], mac_str[18];
-  char *arr[] = {
-    (char *)&mac_str,
-    (char *)&ip_str,
-    (char *)&dns_str,
-    (char *)&gateway_str,
-    (char *)&subnet_str
+void fr12_union_station::http_get_ntp(void *ee, EthernetClient *client) {
+  fr12_ntp_status status;
+  this->ntp->serialize_status(&status);
+
+  fr12_http_json_object objects[] = {
+    FR12_UNION_STATION_JSON(fr12_union_station_json_ntp, ee),
+    FR12_UNION_STATION_JSON(fr12_union_station_json_ntp_status, &status)
   };
+  this->net->http_respond_json(client, 200, objects, 2);
+}
+
+void fr12_union_station::http_route_sched(uint8_t verb, EthernetClient *client, char *query) {
+  if (verb != fr12_union_station_verb_get) {
+    this->do_respond_bad_request(client);
+    return;
+  }
 
-  snprintf_P((char *)&mac_str, sizeof(mac_str), PSTR("%.2x:%.2x:%.2x:%.2x:%.2x:%.2x"), network->mac[0], network->mac[1], network->mac[2], network->mac[3], network->mac[4], network->mac[5]);
-  snprintf_P((char *)&ip_str, sizeof(ip_str), PSTR("%u.%u.%u.%u"), ip[0], ip[1], ip[2], ip[3]);
-  snprintf_P((char *)&dns_str, sizeof(dns_str), PSTR("%u.%u.%u.%u"), dns[0], dns[1], dns[2], dns[3]);
-  snprintf_P((char *)&gateway_str, sizeof(gateway_str), PSTR("%u.%u.%u.%u"), gateway[0], gateway[1], gateway[2], gateway[3]);
-  snprintf_P((char *)&subnet_str, sizeof(subnet_str), PSTR("%u.%u.%u.%u"), subnet[0], subnet[1], subnet[2], subnet[3]);
+  fr12_sched_status status;
+  this->sched->serialize(&status);
 
-  this->net->http_respond_json(client, 200, (const char **)arr, 5);
+  fr12_http_json_object object = FR12_UNION_STATION_JSON(fr12_union_station_json_sched, &status);
+  this->net->http_respond_json(client, 200, &object, 1);
 }
 
-void fr12_union_station::http_get_ntp(void *ee, EthernetClient *client) {
-  fr12_ntp_serialized *ntp = (fr12_ntp_serialized *)ee;
-  char *arr[] = {
-    (char *)&ntp->server
-  };
-  this->net->http_respond_json(client, 200, (const char **)arr, 1);
+void fr12_union_station::http_route_events(uint8_t verb, EthernetClient *client, char *query) {
+  if (verb == fr12_union_station_verb_set && this->http_set_events(query) != fr12_parse_ok) {
+    this->do_respond_bad_request(client);
+    return;
+  }
+
+  fr12_events_serialized events;
+  this->events->list(&events);
+
+  fr12_http_json_object object = { fr12_union_station_json_events, (uint8_t)(1 + 2 * events.count), &events };
+  this->net->http_respond_json(client, 200, &object, 1);
 }
 
-void fr12_union_station::http_get_time(void *ee, EthernetClient *client) {
-  fr12_time_serialized *time = (fr12_time_serialized *)ee;
-  char time_now[11], time_sync_interval[11];
-  char *arr[] = {
-    (char *)&time_now,
-    (char *)&time_sync_interval
-  };
+uint8_t fr12_union_station::http_set_events(char *query) {
+  uint32_t timestamp = 0, remove = 0;
+  uint8_t add = 0, drop = 0, ret;
+  char *name = NULL;
+
+  // "time" and "name" add a target (or rename the one at that time), and
+  // "remove" takes one out by its time. Check everything before changing
+  // anything.
+  while (query != NULL && *query != '\0') {
+    char *key, *value, *next = this->do_split(query, '&');
+    this->do_break_query(query, &key, &value);
+
+    if (strcasecmp_P(key, PSTR("time")) == 0) {
+      if ((ret = fr12_parse_uint(value, 0xffffffffUL, &timestamp)) != fr12_parse_ok) {
+        return ret;
+      }
+      add = 1;
+    }
+    else if (strcasecmp_P(key, PSTR("name")) == 0) {
+      if (strlen(value) >= fr12_event_name_size) {
+        return fr12_parse_overflow;
+      }
+      name = value;
+    }
+    else if (strcasecmp_P(key, PSTR("remove")) == 0) {
+      if ((ret = fr12_parse_uint(value, 0xffffffffUL, &remove)) != fr12_parse_ok) {
+        return ret;
+      }
+      drop = 1;
+    }
+    query = next;
+  }
+
+  if (name != NULL && !add) {
+    return fr12_parse_too_short;
+  }
+  if (drop && this->events->find(remove) == fr12_events_none) {
+    return fr12_parse_invalid;
+  }
+  if (add) {
+    // Past targets would finish as soon as they went in, and so would
+    // ones more than 68 years out, which the countdown takes for past
+    if ((int32_t)(timestamp - this->time->now()) <= 0) {
+      return fr12_parse_invalid;
+    }
+    if (this->events->find(timestamp) == fr12_events_none && this->events->get_count() - drop >= fr12_events_max) {
+      return fr12_parse_overflow;
+    }
+  }
+  if (!add && !drop) {
+    return fr12_parse_ok;
+  }
 
-  snprintf_P((char *)&time_now, sizeof(time_now), PSTR("%lu"), time->seconds);
-  snprintf_P((char *)&time_sync_interval, sizeof(time_sync_interval), PSTR("%lu"), time->sync_interval);
-  this->net->http_respond_json(client, 200, (const char **)arr, 2);
+  if (drop) {
+    this->events->remove(remove);
+  }
+  if (add) {
+    this->events->add(timestamp, name != NULL ? name : "");
+  }
+  this->do_save_events();
+
+  // Count down to whatever's nearest now, unless a finished target is still
+  // up; the next one takes over after it
+  if (!(this->flags & fr12_union_station_complete) || this->event.timestamp == 0) {
+    this->do_select_event();
+    this->do_redraw_screen();
+  }
+  return fr12_parse_ok;
+}
+
+void fr12_union_station::http_get_time(void *ee, EthernetClient *client) {
+  fr12_http_json_object object = FR12_UNION_STATION_JSON(fr12_union_station_json_time, ee);
+  this->net->http_respond_json(client, 200, &object, 1);
 }
 
-void fr12_union_station::http_set_countdown(void *ee_new, void *ee_old, char *key, char *value) {
+uint8_t fr12_union_station::http_set_countdown(void *ee_new, void *ee_old, char *key, char *value) {
   fr12_union_station_serialized *us_new = (fr12_union_station_serialized *)ee_new;
-  fr12_union_station_serialized *us_old = (fr12_union_station_serialized *)ee_old;
 
+  // Targets are set through /set/events. Before 1.4.5 this took "time" as
+  // the one target; that now gets a 400 rather than being dropped, so old
+  // callers find out they have to move to /set/events?time=.
   if (strcasecmp_P(key, PSTR("time")) == 0) {
-    us_new->countdown_to = strtoul(value, NULL, 0);
-    if (us_new->countdown_to < this->time->now()) {
-      us_new->countdown_to = us_old->countdown_to;
-      this->flags &= ~fr12_union_station_complete;
-      this->do_redraw_screen();
+    return fr12_parse_invalid;
+  }
+  else if (strcasecmp_P(key, PSTR("boot_flags")) == 0) {
+    uint8_t ret = fr12_parse_byte(value, &us_new->boot_flags);
+    if (ret != fr12_parse_ok) {
+      return ret;
     }
   }
+
+  return fr12_parse_ok;
 }
 
-void fr12_union_station::http_set_lcd(void *ee_new, void *ee_old, char *key, char *value) {
+uint8_t fr12_union_station::http_set_lcd(void *ee_new, void *ee_old, char *key, char *value) {
   fr12_lcd_serialized *lcd_new = (fr12_lcd_serialized *)ee_new;
   //fr12_lcd_serialized *lcd_old = (fr12_lcd_serialized *)ee_old;
 
+  // Only copy the message if it fits with its terminator
   if (strcasecmp_P(key, PSTR("msg")) == 0) {
-    strncpy((char *)&lcd_new->msg.text, value, sizeof(lcd_new->msg.text));
-  } 
+    if (strlen(value) >= sizeof(lcd_new->msg.text)) {
+      return fr12_parse_overflow;
+    }
+    memset(lcd_new->msg.text, 0x00, sizeof(lcd_new->msg.text));
+    strcpy((char *)lcd_new->msg.text, (const char *)value);
+  }
   else if (strcasecmp_P(key, PSTR("r")) == 0) {
-    lcd_new->msg.r = (uint8_t)strtoul(value, NULL, 0);
+    return fr12_parse_byte(value, &lcd_new->msg.r);
   } 
   else if (strcasecmp_P(key, PSTR("g")) == 0) {
-    lcd_new->msg.g = (uint8_t)strtoul(value, NULL, 0);
+    return fr12_parse_byte(value, &lcd_new->msg.g);
   } 
   else if (strcasecmp_P(key, PSTR("b")) == 0) {
-    lcd_new->msg.b = (uint8_t)strtoul(value, NULL, 0);
+    return fr12_parse_byte(value, &lcd_new->msg.b);
   }
+
+  return fr12_parse_ok;
 }
 
-void fr12_union_station::http_set_net(void *ee_new, void *ee_old, char *key, char *value) {
+uint8_t fr12_union_station::http_set_net(void *ee_new, void *ee_old, char *key, char *value) {
   fr12_net_serialized *network_new = (fr12_net_serialized *)ee_new;
-  fr12_net_serialized *network_old = (fr12_net_serialized *)ee_old;
+  //fr12_net_serialized *network_old = (fr12_net_serialized *)ee_old;
+
   if (strcasecmp_P(key, PSTR("flags")) == 0) {
-    network_new->flags = (uint8_t)strtoul(value, NULL, 0);
+    return fr12_parse_byte(value, &network_new->flags);
   } 
   else if (strcasecmp_P(key, PSTR("mac")) == 0) {
-    if (sscanf_P(value, PSTR("%hhx:%hhx:%hhx:%hhx:%hhx:%hhx"), &network_new->mac[0], &network_new->mac[1], &network_new->mac[2], &network_new->mac[3], &network_new->mac[4], &network_new->mac[5]) != 6) {
-      memcpy(&network_new->mac, &network_old->mac, sizeof(network_new->mac));
-    } 
+    return fr12_parse_mac(value, network_new->mac);
   } 
   else if (strcasecmp_P(key, PSTR("ip")) == 0) {
-    IPAddress ip(network_new->ip);
-    if (sscanf_P(value, PSTR("%hhu.%hhu.%hhu.%hhu"), &ip[0], &ip[1], &ip[2], &ip[3]) == 4) {
-      network_new->ip = ip;
-    }
+    return fr12_parse_ipv4(value, (uint8_t *)&network_new->ip);
   } 
   else if (strcasecmp_P(key, PSTR("dns")) == 0) {
-    IPAddress dns(network_new->dns);
-    if (sscanf_P(value, PSTR("%hhu.%hhu.%hhu.%hhu"), &dns[0], &dns[1], &dns[2], &dns[3]) == 4) {
-      network_new->dns = dns;
-    }
+    return fr12_parse_ipv4(value, (uint8_t *)&network_new->dns);
   } 
   else if (strcasecmp_P(key, PSTR("gateway")) == 0) {
-    IPAddress gateway(network_new->gateway);
-    if (sscanf_P(value, PSTR("%hhu.%hhu.%hhu.%hhu"), &gateway[0], &gateway[1], &gateway[2], &gateway[3]) == 4) {
-      network_new->gateway = gateway;
-    }
+    return fr12_parse_ipv4(value, (uint8_t *)&network_new->gateway);
   } 
   else if (strcasecmp_P(key, PSTR("subnet")) == 0) {
-    IPAddress subnet(network_new->subnet);
-    if (sscanf_P(value, PSTR("%hhu.%hhu.%hhu.%hhu"), &subnet[0], &subnet[1], &subnet[2], &subnet[3]) == 4) {
-      network_new->subnet = subnet;
-    }
+    return fr12_parse_ipv4(value, (uint8_t *)&network_new->subnet);
   }
+
+  return fr12_parse_ok;
 }
 
-void fr12_union_station::http_set_ntp(void *ee_new, void *ee_old, char *key, char *value) {
+uint8_t fr12_union_station::http_set_ntp(void *ee_new, void *ee_old, char *key, char *value) {
   fr12_ntp_serialized *ntp_new = (fr12_ntp_serialized *)ee_new;
   //fr12_ntp_serialized *ntp_old = (fr12_ntp_serialized *)ee_old;
+  uint8_t a;
   
-  size_t sz = strlen(key);
-  // Only copy if it's valid
-  if (strcasecmp_P(key, PSTR("server")) == 0 && sz < sizeof(ntp_new->server) && sz != 0) {
-    strcpy((char *)&ntp_new->server, (const char *)value);
+  // "server" is the first, "server1" and on the rest
+  if (strcasecmp_P(key, PSTR("server")) == 0) {
+    a = 0;
+  }
+  else if (strncasecmp_P(key, PSTR("server"), 6) == 0 && key[6] >= '1' && key[6] < '0' + fr12_ntp_peers && key[7] == '\0') {
+    a = key[6] - '0';
   }
+  else {
+    return fr12_parse_ok;
+  }
+
+  // Only copy if it fits. The others can be emptied, but not the first.
+  size_t sz = strlen(value);
+  if (sz == 0 && a == 0) {
+    return fr12_parse_empty;
+  }
+  if (sz >= sizeof(ntp_new->server[a])) {
+    return fr12_parse_overflow;
+  }
+  memset(ntp_new->server[a], 0x00, sizeof(ntp_new->server[a]));
+  strcpy((char *)ntp_new->server[a], (const char *)value);
+
+  return fr12_parse_ok;
 }
 
-void fr12_union_station::http_set_time(void *ee_new, void *ee_old, char *key, char *value) {
+uint8_t fr12_union_station::http_set_time(void *ee_new, void *ee_old, char *key, char *value) {
   fr12_time_serialized *time_new = (fr12_time_serialized *)ee_new;
   fr12_time_serialized *time_old = (fr12_time_serialized *)ee_old;
+
   if (strcasecmp_P(key, PSTR("time")) == 0) {
-    time_new->seconds = strtoul(value, NULL, 0);
+    uint32_t seconds;
+    uint8_t ret = fr12_parse_uint(value, 0xffffffffUL, &seconds);
+    if (ret != fr12_parse_ok) {
+      return ret;
+    }
+
+    time_new->seconds = seconds;
     if (time_new->seconds < this->countdown->get_timestamp()) {
       time_new->seconds = time_old->seconds;
       this->flags &= ~fr12_union_station_complete;
@@ -462,24 +600,51 @@ void fr12_union_station::http_set_time(void *ee_new, void *ee_old, char *key, ch
     }
   } 
   else if (strcasecmp_P(key, PSTR("sync_interval")) == 0) {
-    time_new->sync_interval = strtoul(value, NULL, 0);
+    uint32_t sync_interval;
+    uint8_t ret = fr12_parse_uint(value, 0xffffffffUL, &sync_interval);
+    if (ret != fr12_parse_ok) {
+      return ret;
+    }
+
+    time_new->sync_interval = sync_interval;
   }
+
+  return fr12_parse_ok;
+}
+
+void fr12_union_station::do_respond_bad_request(EthernetClient *client) {
+  this->net->http_respond(client, 400);
 }
 
 void fr12_union_station::do_redraw_screen() {
+  // The splash screen has the display until boot is done
+  if (this->flags & fr12_union_station_splash) {
+    return;
+  }
+
   // Clear the screen and all areas
   this->glcd->hw->ClearScreen();
   this->glcd->title->CursorToXY(fr12_glcd_margin_left, 10);
   this->glcd->caption->CursorToXY(this->glcd->hw->CenterX + 1, 17);
   this->glcd->countdown->CursorToXY(0, 0);
   this->glcd->status->CursorToXY(0, 0);
+  this->countdown->invalidate();
   
   // Put the title text up
   this->glcd->title->Puts_P(PSTR("FR 12"));
   
-  // Either put "COUNTDOWN!" or "IT'S HERE!" depending on flags
+  // "IT'S HERE!" over a zeroed countdown once the target finishes (or
+  // "NO TARGETS" if there isn't one), otherwise the target's name or
+  // "COUNTDOWN!"
   if (this->flags & fr12_union_station_complete) {
-    this->glcd->caption->Puts_P(PSTR("IT'S HERE!"));
+    if (this->event.timestamp != 0) {
+      this->glcd->caption->Puts_P(PSTR("IT'S HERE!"));
+    } else {
+      this->glcd->caption->Puts_P(PSTR("NO TARGETS"));
+    }
+    this->glcd->countdown->Puts_P(PSTR(" 00:00:00:00.00"));
+  } else if (this->event.name[0] != '\0') {
+    this->glcd->caption->Puts(this->event.name);
   } else {
     this->glcd->caption->Puts_P(PSTR("COUNTDOWN!"));
   }
@@ -499,42 +664,381 @@ void fr12_union_station::do_status_reset() {
   }
 }
 
-void fr12_union_station::do_sync_ntp() {
-  uint8_t tries = 0;
-  uint32_t t = 0;
+void fr12_union_station::do_ntp_step() {
+  uint8_t inaccurate = this->flags & fr12_union_station_time_inaccurate;
+  uint8_t booting = this->flags & fr12_union_station_booting, events;
+  fr12_ntp_sample sample;
 
-  while (t == 0 && tries < fr12_union_station_sync_max_tries) {
-    this->glcd->status->ClearArea();
-    if (this->ntp->get_hostname() != NULL) {
-      this->glcd->status->Printf_P(PSTR("%s [%u]"), this->ntp->get_hostname(), ++tries);
+  switch (this->ntp->poll(&sample)) {
+  case fr12_ntp_event_sent:
+    if (booting) {
+      this->glcd->status->ClearArea();
+      this->glcd->status->Printf_P(PSTR("NTP: %u servers [%u]"), this->ntp->get_peers(), this->ntp->get_tries());
+    }
+    return;
+  case fr12_ntp_event_synced:
+    events = this->time->discipline(sample.offset);
+
+    // Keep the drift estimate across reboots. Only the drift (and the
+    // CRC) is rewritten; the time itself goes to the journal.
+    if (events & fr12_time_event_drift) {
+      fr12_time_serialized time;
+      this->config->read(&time);
+      time.drift = this->time->get_drift();
+      this->config->write(&time);
+    }
+
+    // The journal stands still while the power's off, so the first step
+    // can jump past targets nobody saw. They're dropped here, before the
+    // display can finish them. A finished target that's still up moves on
+    // when its hold is over.
+    if ((events & fr12_time_event_step) && (!(this->flags & fr12_union_station_complete) || this->event.timestamp == 0)) {
+      uint32_t timestamp = this->event.timestamp;
+      this->do_select_event();
+      if (this->event.timestamp != timestamp) {
+        this->do_redraw_screen();
+      }
+    }
+    this->flags &= ~fr12_union_station_time_inaccurate;
+    if (booting) {
+      // Milliseconds once it's close, seconds before that
+      this->glcd->status->ClearArea();
+      if ((sample.offset >> 32) == 0 || (sample.offset >> 32) == -1) {
+        this->glcd->status->Printf_P(PSTR("Offset: %+ldms"), (int32_t)((sample.offset * 1000) >> 32));
+      }
+      else {
+        this->glcd->status->Printf_P(PSTR("Offset: %+lds"), (int32_t)(sample.offset >> 32));
+      }
+    }
+    break;
+  case fr12_ntp_event_failed:
+    this->flags |= fr12_union_station_time_inaccurate;
+    if (booting) {
+      this->glcd->status->ClearArea();
+      this->glcd->status->Puts_P(PSTR("Error syncing time."));
+    }
+    break;
+  default:
+    return;
+  }
+
+  // do_boot() leaves the result up for a moment. Later rounds only show
+  // when the clock becomes (in)accurate.
+  if (!booting && (this->flags & fr12_union_station_time_inaccurate) != inaccurate) {
+    this->do_status_reset();
+  }
+}
+
+void fr12_union_station::do_display() {
+  // Nothing to draw on until the splash screen is gone
+  if (this->flags & fr12_union_station_splash) {
+    return;
+  }
+
+  // A finished target stays up for a while, then the next one takes over
+  if (this->flags & fr12_union_station_complete) {
+    if (this->event.timestamp != 0 && millis() - this->complete_since >= fr12_union_station_complete_hold) {
+      this->do_select_event();
+      this->do_redraw_screen();
+    }
+    return;
+  }
+
+  // Target not yet reached
+  if (!this->countdown->target_reached()) {
+    // Update countdown
+    this->countdown->update(this->time);
+
+    // The countdown just finished. Update the message.
+    if (this->countdown->target_reached() && !(this->flags & fr12_union_station_complete)) {
+      // We're done! The target comes out of the table now.
+      this->flags |= fr12_union_station_complete;
+      this->complete_since = millis();
+      this->do_retire_event();
+      
+      // Make a LCD message, under the target's name if it has one
+      fr12_lcd_message message;
+      if (this->event.name[0] != '\0') {
+        snprintf_P((char *)&message.text, sizeof(message.text), PSTR("%s\nHoist the sails"), this->event.name);
+      } else {
+        strncpy_P((char *)&message.text, PSTR("FR 2012\nHoist the sails"), sizeof(message.text));
+      }
+      
+      // Make it red
+      message.r = 255;
+      message.g = message.b = 0;
+      
+      // Totally redraw the screen, zeroing out the countdown
+      this->do_redraw_screen();
+      
+      // Set the message on the text LCD
+      this->lcd->set_message(&message);
     }
+    
+    // Otherwise, redraw from the first thing that changed
+    else if (!this->countdown->target_reached()) {
+      char text[fr12_countdown_digits + 6], *c = text;
+      uint16_t changes = this->countdown->get_changes();
+      uint8_t colon = this->flags & fr12_union_station_colon, first = fr12_countdown_digit_days, start = 0xff;
 
-    // Send a packet
-    uint32_t then = millis();
-    this->ntp->send_packet();
+      // Days show at least two digits. Losing one leaves a stray digit at
+      // the end, so that starts over.
+      while (first < fr12_countdown_digit_hours - 2 && this->countdown->get_digit(first) == 0) {
+        first++;
+      }
+      if (first != this->display_first) {
+        this->glcd->countdown->ClearArea();
+        this->display_first = first;
+        start = 0;
+      }
+
+      // Separators go before hours, minutes, seconds and centiseconds, and
+      // blink with the colon
+      *c++ = ' ';
+      for (uint8_t a = first; a < fr12_countdown_digits; a++) {
+        if (a >= fr12_countdown_digit_hours && !(a & 1)) {
+          if (colon != this->display_colon && start == 0xff) {
+            start = c - text;
+          }
+          *c++ = colon ? (a == fr12_countdown_digit_cs ? '.' : ':') : ' ';
+        }
+        if ((changes & (1 << a)) && start == 0xff) {
+          start = c - text;
+        }
+        *c++ = '0' + this->countdown->get_digit(a);
+      }
+      *c = '\0';
+      this->display_colon = colon;
 
-    // Wait for a response
-    while (millis() - then < fr12_union_station_ntp_timeout) {
-      t = this->ntp->get_time();
-      if (t > 0) {
-        break;
+      if (start != 0xff) {
+        char saved = text[start];
+        text[start] = '\0';
+        this->glcd->countdown->CursorToXY(this->glcd->countdown->StringWidth(text), 0);
+        text[start] = saved;
+        this->glcd->countdown->Puts(&text[start]);
       }
     }
+  }
+}
+
+void fr12_union_station::do_tick() {
+  // Keep the uptime counting
+  this->time->update();
+  if (this->time->now() == this->tick_seconds) {
+    return;
+  }
+  this->tick_seconds = this->time->now();
+
+  // Toggle the heartbeat LED
+  PORTB ^= _BV(PB7);
+
+  // Toggle the colon
+  this->flags ^= fr12_union_station_colon;
+}
+
+void fr12_union_station::do_http() {
+  this->net->handle_http();
+}
+
+void fr12_union_station::do_net() {
+  // Keep the lease and link up once boot has them
+  if (this->flags & fr12_union_station_booting) {
+    return;
+  }
+
+  uint8_t events = this->net->supervise(this->time->now(), this->time->get_flags() & fr12_time_disciplined);
+  if (events & fr12_net_event_lease) {
+    this->do_save_lease();
+  }
+  if (events & fr12_net_event_relink) {
+    this->ntp->restart();
+  }
+}
+
+void fr12_union_station::do_save_events() {
+  fr12_events_serialized events;
+  this->events->serialize(&events);
+  this->config->write(&events);
+}
+
+void fr12_union_station::do_select_event() {
+  uint8_t retired = 0;
+
+  // Targets that went by unseen (while powered off, or while the last one
+  // was up) are dropped
+  while (this->events->peek(&this->event) && this->event.timestamp < this->time->now()) {
+    this->events->pop();
+    retired = 1;
+  }
+  if (retired) {
+    this->do_save_events();
+  }
+
+  // Count down to the nearest. With none left there's nothing to count
+  // down to, which shows as finished. Leaving a finished target puts the
+  // configured LCD message back in place of the red one.
+  if (this->events->get_count() > 0) {
+    if (this->flags & fr12_union_station_complete) {
+      fr12_lcd_serialized lcd;
+      this->config->read(&lcd);
+      this->lcd->configure(&lcd);
+    }
+    this->flags &= ~fr12_union_station_complete;
+  }
+  else {
+    memset(&this->event, 0x00, sizeof(this->event));
+    this->flags |= fr12_union_station_complete;
+  }
+
+  delete this->countdown;
+  this->countdown = new fr12_countdown(this->event.timestamp);
+}
+
+void fr12_union_station::do_retire_event() {
+  fr12_event nearest;
+
+  // Unless it was already removed over HTTP
+  if (this->events->peek(&nearest) && nearest.timestamp == this->event.timestamp) {
+    this->events->pop();
+    this->do_save_events();
+  }
+}
+
+void fr12_union_station::do_boot() {
+  IPAddress addresses[4];
+
+  // Nothing here keeps a local across a wait; see coro.h
+  FR12_CORO_BEGIN(&this->boot);
+
+  // Splash screen: the MAC, then how we're getting an address
+  if (this->flags & fr12_union_station_splash) {
+    {
+      uint8_t *mac = this->net->get_mac();
+      this->glcd->status->ClearArea();
+      this->glcd->status->Puts_P(PSTR("MAC: "));
+      this->glcd->status->Printf_P(PSTR("%.2x:%.2x:%.2x:%.2x:%.2x:%.2x"), mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+    FR12_CORO_DELAY(&this->boot, fr12_union_station_splash_pause);
 
-    // Set time
     this->glcd->status->ClearArea();
-    if (t > 0) {
-      int32_t delta = t - this->time->now();
-      this->time->set(t);
-      this->glcd->status->Printf_P(PSTR("Offset: %+lds"), delta);
-      this->flags &= ~fr12_union_station_time_inaccurate;
+    if (!(this->net->get_flags() & fr12_net_use_dhcp)) {
+      this->glcd->status->Puts_P(PSTR("Using static IP."));
+      this->net->begin_ethernet_static();
+      FR12_CORO_DELAY(&this->boot, fr12_union_station_splash_pause);
+    }
+    else if (this->net->begin_ethernet_lease(this->time->now())) {
+      this->glcd->status->Puts_P(PSTR("Using cached lease."));
+    }
+    else {
+      this->flags |= fr12_union_station_dhcp_pending;
     }
   }
 
-  if (t == 0) {
-    this->glcd->status->Puts_P(PSTR("Error syncing time."));
-    this->flags |= fr12_union_station_time_inaccurate;
+  // The Ethernet library's DHCP client blocks, so this is one long step
+  // rather than something to wait on. Without a lease, it's back to the
+  // static address.
+  if (this->flags & fr12_union_station_dhcp_pending) {
+    this->flags &= ~fr12_union_station_dhcp_pending;
+    this->glcd->status->ClearArea();
+    this->glcd->status->Puts_P(PSTR("DHCP..."));
+    if (this->net->begin_ethernet_dhcp() != 0) {
+      this->do_save_lease();
+    }
+    else {
+      this->glcd->status->ClearArea();
+      this->glcd->status->Puts_P(PSTR("Using static IP."));
+      this->net->begin_ethernet_static();
+      if (this->flags & fr12_union_station_splash) {
+        FR12_CORO_DELAY(&this->boot, fr12_union_station_splash_pause);
+      }
+    }
+  }
+
+  // Serve HTTP as soon as there's an address (a fast boot already is), and
+  // show the address
+  if (this->flags & fr12_union_station_splash) {
+    this->net->begin_http(&fr12_union_station::http_handler);
+    for (this->boot_address = 0; this->boot_address < 4; this->boot_address++) {
+      this->net->get_addresses((IPAddress *)&addresses);
+      this->glcd->status->ClearArea();
+      this->glcd->status->Puts_P(fr12_union_station_address_names[this->boot_address]);
+      this->glcd->status->Printf_P(PSTR(": %u.%u.%u.%u"), addresses[this->boot_address][0], addresses[this->boot_address][1], addresses[this->boot_address][2], addresses[this->boot_address][3]);
+      FR12_CORO_DELAY(&this->boot, fr12_union_station_splash_pause);
+    }
+    this->glcd->status->ClearArea();
+    this->glcd->status->Puts_P(PSTR("Syncing local clock..."));
+  }
+  else {
+    this->net->get_addresses((IPAddress *)&addresses);
+    this->glcd->status->ClearArea();
+    this->glcd->status->Printf_P(PSTR("IP: %u.%u.%u.%u"), addresses[0][0], addresses[0][1], addresses[0][2], addresses[0][3]);
+  }
+
+  // First NTP round. The NTP task runs it and shows how it went; the result
+  // stays up for a moment.
+  this->net->get_addresses((IPAddress *)&addresses);
+  this->ntp->begin(addresses[1], this->time);
+  this->ntp->sync();
+  FR12_CORO_WAIT_UNTIL(&this->boot, this->ntp->get_state() == fr12_ntp_idle);
+  FR12_CORO_DELAY(&this->boot, fr12_union_station_status_hold);
+
+  // Hand the screen over to the countdown
+  if (this->flags & fr12_union_station_splash) {
+    this->glcd->status->ClearArea();
+    this->glcd->status->Printf_P(PSTR("Interval: %lus"), this->time->get_sync_interval());
+    FR12_CORO_DELAY(&this->boot, fr12_union_station_splash_pause);
+    this->flags &= ~fr12_union_station_splash;
+    this->do_redraw_screen();
+  }
+  else {
+    this->do_status_reset();
   }
+
+  // Boot's done, so the task stops
+  this->flags &= ~fr12_union_station_booting;
+  this->sched->set_period(fr12_union_station_task_boot, 0);
+
+  FR12_CORO_END(&this->boot);
+}
+
+void fr12_union_station::do_journal() {
+  // Save the current time to the EEPROM journal every so often
+  this->config->write_time_journal(this->time->now());
+}
+
+void fr12_union_station::do_schedule() {
+  // Start every task from the table
+  for (uint8_t a = 0; a < fr12_union_station_task_count; a++) {
+    fr12_union_station_task task;
+    memcpy_P(&task, &tasks[a], sizeof(task));
+    this->sched->set(a, task.callback, a, task.period, task.budget);
+  }
+  this->do_schedule_sync();
+}
+
+void fr12_union_station::do_schedule_sync() {
+  // Periods are in milliseconds and stop at fr12_sched_period_max, so
+  // intervals past about 24.8 days are capped
+  uint32_t interval = this->time->get_sync_interval();
+  this->sched->set_period(fr12_union_station_task_sync, interval > (uint32_t)fr12_sched_period_max / 1000 ? (uint32_t)fr12_sched_period_max : interval * 1000);
+}
+
+void fr12_union_station::do_save_lease() {
+  fr12_net_lease_serialized lease;
+  this->net->serialize_lease(&lease, this->time->now() + fr12_net_lease_time);
+  this->config->write_lease(&lease);
+}
+
+char *fr12_union_station::do_split(char *str, char delim) {
+  // Terminates str at the first delim and returns what follows it
+  for (; *str != '\0'; str++) {
+    if (*str == delim) {
+      *str++ = '\0';
+      break;
+    }
+  }
+
+  return str;
 }
 
 void fr12_union_station::do_break_query(char *c, char **key, char **value) {
@@ -556,10 +1060,3 @@ void fr12_union_station::do_break_query(char *c, char **key, char **value) {
   *value = v;
 }
 
-char *fr12_union_station::do_find_query(char *str) {
-  while(*str != '\0') {
-    str++;
-  }
-
-  return str + 1;
-}
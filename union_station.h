@@ -8,20 +8,26 @@
 #define FR12_UNION_STATION_H
 
 #include "defs.h"
+#include "parse.h"
+#include "coro.h"
+#include "events.h"
 
 // Mixed variables
 enum {
-  // Countdown
+  // Default countdown target
   fr12_union_station_countdown_to = 1327626000L,
   
-  // Configuration write interval
-  fr12_union_station_config_write_interval = 5,
+  // How long a finished target stays up before the next one (ms)
+  fr12_union_station_complete_hold = 60000L,
   
-  // NTP try timeout
-  fr12_union_station_ntp_timeout = 1500,
+  // Time journal write interval (ms)
+  fr12_union_station_config_write_interval = 5000,
   
-  // Max NTP tries
-  fr12_union_station_sync_max_tries = 5,
+  // How long boot results stay in the status area
+  fr12_union_station_status_hold = 1500,
+  
+  // How long each splash screen step stays up
+  fr12_union_station_splash_pause = 1500,
   
   // Reset pin (high)
   fr12_union_station_reset_pin = 12,
@@ -30,16 +36,51 @@ enum {
   fr12_union_station_heartbeat_pin = 13
 };
 
+// Boot flags, kept in the EEPROM
+enum {
+  fr12_union_station_boot_fast = (1 << 0)
+};
+
+// Scheduler tasks. The slot is also the priority, most urgent first.
+enum {
+  fr12_union_station_task_display = 0,
+  fr12_union_station_task_tick,
+  fr12_union_station_task_ntp,
+  fr12_union_station_task_http,
+  fr12_union_station_task_net,
+  fr12_union_station_task_boot,
+  fr12_union_station_task_journal,
+  fr12_union_station_task_sync,
+  fr12_union_station_task_count
+};
+
+// HTTP verbs
+enum {
+  fr12_union_station_verb_get = 0,
+  fr12_union_station_verb_set
+};
+
+// HTTP routes
+enum {
+  fr12_union_station_route_name_len = 10
+};
+
 // Flags
 enum {
   fr12_union_station_time_inaccurate = (1 << 0),
   fr12_union_station_colon = (1 << 1),
-  fr12_union_station_complete = (1 << 2)
+  fr12_union_station_complete = (1 << 2),
+  fr12_union_station_booting = (1 << 3),
+  fr12_union_station_splash = (1 << 4),
+  fr12_union_station_dhcp_pending = (1 << 5)
 };
 
 // Built-in classes
 class EthernetClient;
 
+// Structs
+struct fr12_http_request;
+
 // FR 12 classes
 class fr12_union_station;
 class fr12_config;
@@ -49,6 +90,8 @@ class fr12_net;
 class fr12_ntp;
 class fr12_time;
 class fr12_countdown;
+class fr12_events;
+class fr12_sched;
 
 // Serialization structs
 struct fr12_union_station_serialized;
@@ -58,7 +101,27 @@ typedef void (fr12_config::*fr12_config_write_callback)(void *);
 
 // HTTP set callback
 typedef void (fr12_union_station::*fr12_union_station_http_get_callback)(void *, EthernetClient *);
-typedef void (fr12_union_station::*fr12_union_station_http_set_callback)(void *, void *, char *, char *);
+typedef uint8_t (fr12_union_station::*fr12_union_station_http_set_callback)(void *, void *, char *, char *);
+
+// HTTP route callback
+typedef void (fr12_union_station::*fr12_union_station_http_route_callback)(uint8_t, EthernetClient *, char *);
+
+// One module in the HTTP API, served under /get/<name> and /set/<name>
+struct fr12_union_station_route {
+  char name[fr12_union_station_route_name_len];
+  fr12_union_station_http_route_callback route;
+};
+
+// Task callback
+typedef void (fr12_union_station::*fr12_union_station_task_callback)();
+
+// A task the scheduler runs every period (ms), and how long (us) it
+// should take
+struct fr12_union_station_task {
+  fr12_union_station_task_callback callback;
+  uint16_t period;
+  uint16_t budget;
+};
 
 class fr12_union_station {
 public:
@@ -80,9 +143,32 @@ public:
   
   // Handlers
   void sync_handler();
-  void http_handler(EthernetClient *client, char *path);
+  void http_handler(EthernetClient *client, fr12_http_request *request);
   
 private:
+  // HTTP routing
+  template <typename T> T *http_module();
+  
+  template <typename T, typename U, fr12_union_station_http_get_callback get, fr12_union_station_http_set_callback set, fr12_config_write_callback write> void http_route(uint8_t verb, EthernetClient *client, char *query) {
+    T *module = this->http_module<T>();
+    
+    // Sets answer with the configuration they leave behind, or 400 if a value didn't parse
+    if (verb == fr12_union_station_verb_set && this->http_set<T, U>(set, write, module, query) != fr12_parse_ok) {
+      this->do_respond_bad_request(client);
+      return;
+    }
+    this->http_get<T, U>(get, module, client);
+  }
+  
+  static const fr12_union_station_route http_routes[] PROGMEM;
+  
+  // Scheduler counters are read-only, so they skip the template
+  void http_route_sched(uint8_t verb, EthernetClient *client, char *query);
+  
+  // Targets are added and removed rather than edited in place
+  void http_route_events(uint8_t verb, EthernetClient *client, char *query);
+  uint8_t http_set_events(char *query);
+  
   // HTTP getters
   template <typename T, typename U> void http_get(fr12_union_station_http_get_callback callback, T *module, EthernetClient *client) {
     U var;
@@ -97,7 +183,7 @@ private:
   void http_get_time(void *ee, EthernetClient *client);
   
   // HTTP setters
-  template <typename T, typename U> void http_set(fr12_union_station_http_set_callback callback, fr12_config_write_callback write, T *module, char *query) {
+  template <typename T, typename U> uint8_t http_set(fr12_union_station_http_set_callback callback, fr12_config_write_callback write, T *module, char *query) {
     // Desired and previous configuration
     U var, old_var;
     
@@ -107,40 +193,72 @@ private:
     // Copy it into the new configuration
     memcpy(&var, &old_var, sizeof(U));
     
-    // Break up the query
-    query = strtok(this->do_find_query(query), "&");
-    
-    // Edit configuration variables
-    while (query != NULL) {
-      char *key, *value;
+    // Edit configuration variables, one "&"-separated pair at a time. Nothing
+    // is kept if any of them is bad.
+    while (query != NULL && *query != '\0') {
+      char *key, *value, *next = this->do_split(query, '&');
       this->do_break_query(query, &key, &value);
-      ((this)->*(callback))(&var, &old_var, key, value);
-      query = strtok(NULL, "&");
+      
+      uint8_t ret = ((this)->*(callback))(&var, &old_var, key, value);
+      if (ret != fr12_parse_ok) {
+        return ret;
+      }
+      query = next;
     }
     
     // Write configuration (if necessary)
     if (memcmp(&var, &old_var, sizeof(U)) != 0) {
       ((this->config)->*(write))(&var);
     }
+    return fr12_parse_ok;
   }
   
-  void http_set_countdown(void *ee_new, void *ee_old, char *key, char *value);
-  void http_set_lcd(void *ee_new, void *ee_old, char *key, char *value);
-  void http_set_net(void *ee_new, void *ee_old, char *key, char *value);
-  void http_set_ntp(void *ee_new, void *ee_old, char *key, char *value);
-  void http_set_time(void *ee_new, void *ee_old, char *key, char *value);
+  uint8_t http_set_countdown(void *ee_new, void *ee_old, char *key, char *value);
+  uint8_t http_set_lcd(void *ee_new, void *ee_old, char *key, char *value);
+  uint8_t http_set_net(void *ee_new, void *ee_old, char *key, char *value);
+  uint8_t http_set_ntp(void *ee_new, void *ee_old, char *key, char *value);
+  uint8_t http_set_time(void *ee_new, void *ee_old, char *key, char *value);
   
   // Utilities
+  void do_respond_bad_request(EthernetClient *client);
   void do_redraw_screen();
   void do_status_reset();
-  void do_sync_ntp();
+  void do_save_lease();
+  void do_save_events();
+  void do_select_event();
+  void do_retire_event();
+  void do_schedule();
+  void do_schedule_sync();
+  
+  // Tasks
+  void do_display();
+  void do_tick();
+  void do_ntp_step();
+  void do_http();
+  void do_net();
+  void do_boot();
+  void do_journal();
+  
+  static const fr12_union_station_task tasks[] PROGMEM;
   
   // HTTP queries
-  char *do_find_query(char *str);
+  char *do_split(char *str, char delim);
   void do_break_query(char *str, char **key, char **value);
   
-  // Synchronization index
-  uint16_t sync_index;
+  // Last second the tick saw
+  uint32_t tick_seconds;
+  
+  // The countdown as last drawn: its first day digit, and the colon
+  uint8_t display_first, display_colon;
+  
+  // The target being counted down to (a zero timestamp if there's none),
+  // and when it finished
+  fr12_event event;
+  uint32_t complete_since;
+  
+  // Boot coroutine, and which address the splash screen is showing
+  uint8_t boot_flags, boot_address;
+  fr12_coro boot;
 protected:
   // Pointers to all FR 12 components
   fr12_config *config;
@@ -150,6 +268,8 @@ protected:
   fr12_ntp *ntp;
   fr12_time *time;
   fr12_countdown *countdown;
+  fr12_events *events;
+  fr12_sched *sched;
   
   // Global flags
   uint8_t flags;